@@ -0,0 +1,599 @@
+/*
+Copyright (C) 2000 - 2016 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "iNES/BundleIndex.h"
+#include "iNES/Error.h"
+#include "iNES/Rom.h"
+#include "Crc32.h"
+#include "Tar.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace iNES {
+namespace {
+
+constexpr size_t WindowSize  = 32768;
+constexpr size_t ChunkSize   = 16384;
+constexpr size_t TrailerSize = 8;
+constexpr size_t EdgeSize    = 0x10000;
+constexpr char IndexMagic[8] = {'i', 'N', 'E', 'S', 'Z', 'I', 'X', '2'};
+
+using File = std::unique_ptr<FILE, int (*)(FILE *)>;
+
+/* owns an initialized inflate stream */
+struct Inflater {
+	~Inflater() {
+		inflateEnd(&strm);
+	}
+
+	z_stream strm = {};
+};
+
+/*------------------------------------------------------------------------------
+// Name: open_file
+//----------------------------------------------------------------------------*/
+File open_file(const std::string &filename) {
+
+	File file(fopen(filename.c_str(), "rb"), fclose);
+	if (!file) {
+		throw ines_open_failed();
+	}
+
+	return file;
+}
+
+/*------------------------------------------------------------------------------
+// Name: fill_input
+// Desc: refills the input of strm once it has all been consumed, returns false
+//       at end of file
+//----------------------------------------------------------------------------*/
+bool fill_input(z_stream &strm, FILE *file, uint8_t *input) {
+
+	if (strm.avail_in != 0) {
+		return true;
+	}
+
+	strm.avail_in = static_cast<uInt>(fread(input, 1, ChunkSize, file));
+	strm.next_in  = input;
+
+	if (ferror(file)) {
+		throw ines_read_failed();
+	}
+
+	return strm.avail_in != 0;
+}
+
+/*------------------------------------------------------------------------------
+// Name: modification_time
+// Desc: the nanosecond resolution time has a different name on Apple systems
+//----------------------------------------------------------------------------*/
+void modification_time(const struct stat &st, int64_t &sec, int64_t &nsec) {
+#if defined(__APPLE__)
+	sec  = static_cast<int64_t>(st.st_mtimespec.tv_sec);
+	nsec = static_cast<int64_t>(st.st_mtimespec.tv_nsec);
+#else
+	sec  = static_cast<int64_t>(st.st_mtim.tv_sec);
+	nsec = static_cast<int64_t>(st.st_mtim.tv_nsec);
+#endif
+}
+
+/*------------------------------------------------------------------------------
+// Name: edge_crc
+// Desc: CRC32 of up to EdgeSize bytes of file starting at offset
+//----------------------------------------------------------------------------*/
+uint32_t edge_crc(FILE *file, uint64_t offset) {
+
+	if (fseeko(file, static_cast<off_t>(offset), SEEK_SET) != 0) {
+		throw ines_read_failed();
+	}
+
+	auto buffer       = std::make_unique<uint8_t[]>(EdgeSize);
+	const size_t size = fread(buffer.get(), 1, EdgeSize, file);
+
+	if (ferror(file)) {
+		throw ines_read_failed();
+	}
+
+	return ines_crc32(buffer.get(), size, 0);
+}
+
+}
+
+/*-----------------------------------------------------------------------------
+// Name: BundleIndex
+//---------------------------------------------------------------------------*/
+BundleIndex::BundleIndex(const char *filename, uint64_t span)
+	: filename_(filename) {
+
+	assert(filename != nullptr);
+
+	File file = open_file(filename_);
+
+	struct stat st;
+	if (fstat(fileno(file.get()), &st) != 0) {
+		throw ines_open_failed();
+	}
+
+	modification_time(st, fingerprint_.mtime_sec, fingerprint_.mtime_nsec);
+	fingerprint_.size     = static_cast<uint64_t>(st.st_size);
+	fingerprint_.head_crc = edge_crc(file.get(), 0);
+	fingerprint_.tail_crc = edge_crc(file.get(), fingerprint_.size - std::min<uint64_t>(fingerprint_.size, EdgeSize));
+	file.reset();
+
+	const std::string index = filename_ + ".idx";
+	if (read_index(index)) {
+		return;
+	}
+
+	build(span);
+
+	/* a bundle in a read-only location simply goes without a saved index */
+	try {
+		write(index.c_str());
+	} catch (const ines_error &) {
+	}
+}
+
+/*-----------------------------------------------------------------------------
+// Name: build
+// Desc: inflates the whole bundle once, recording access points and the tar
+//       members as they go by
+//---------------------------------------------------------------------------*/
+void BundleIndex::build(uint64_t span) {
+
+	File file = open_file(filename_);
+
+	Inflater inflater;
+	z_stream &strm = inflater.strm;
+
+	if (inflateInit2(&strm, 31) != Z_OK) {
+		throw ines_read_failed();
+	}
+
+	std::vector<Member> members;
+	TarParser tar(
+		[&members](const std::string &name, uint64_t offset, uint64_t size) {
+			members.push_back(Member{name, offset, size});
+		},
+		nullptr);
+
+	auto input  = std::make_unique<uint8_t[]>(ChunkSize);
+	auto window = std::make_unique<uint8_t[]>(WindowSize);
+
+	uint64_t total_in  = 0;
+	uint64_t total_out = 0;
+	uint64_t last      = 0;
+
+	while (!tar.finished()) {
+		if (strm.avail_in == 0) {
+			if (!fill_input(strm, file.get(), input.get())) {
+				throw ines_bad_archive();
+			}
+			total_in += strm.avail_in;
+		}
+
+		/* the output buffer doubles as the circular window */
+		if (strm.avail_out == 0) {
+			strm.next_out  = window.get();
+			strm.avail_out = WindowSize;
+		}
+
+		uint8_t *const out = strm.next_out;
+		const int ret      = inflate(&strm, Z_BLOCK);
+		const size_t count = strm.next_out - out;
+
+		if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+			throw ines_corrupt_data();
+		}
+
+		total_out += count;
+		tar.feed(out, count);
+
+		if (ret == Z_STREAM_END) {
+			/* another gzip member may follow, anything else ends the bundle */
+			if (strm.avail_in == 0) {
+				if (!fill_input(strm, file.get(), input.get())) {
+					break;
+				}
+				total_in += strm.avail_in;
+			}
+
+			if (strm.next_in[0] != 0x1f) {
+				break;
+			}
+
+			inflateReset(&strm);
+			continue;
+		}
+
+		/* at a block boundary which is not the end of the stream? */
+		if ((strm.data_type & 128) && !(strm.data_type & 64) && (total_out == 0 || total_out - last > span)) {
+
+			const size_t left = strm.avail_out;
+			std::vector<uint8_t> ordered(WindowSize);
+			memcpy(ordered.data(), window.get() + WindowSize - left, left);
+			memcpy(ordered.data() + left, window.get(), WindowSize - left);
+
+			const size_t window_size = static_cast<size_t>(std::min<uint64_t>(total_out, WindowSize));
+			uLongf length            = compressBound(window_size);
+
+			AccessPoint point;
+			point.out         = total_out;
+			point.in          = total_in - strm.avail_in;
+			point.bits        = static_cast<uint8_t>(strm.data_type & 7);
+			point.window_size = static_cast<uint32_t>(window_size);
+			point.window.resize(length);
+
+			if (compress2(point.window.data(), &length, ordered.data() + WindowSize - window_size, window_size, Z_DEFAULT_COMPRESSION) != Z_OK) {
+				throw ines_corrupt_data();
+			}
+
+			point.window.resize(length);
+			points_.push_back(std::move(point));
+			last = total_out;
+		}
+	}
+
+	/* when a name appears more than once, the last one wins like it does for tar */
+	std::stable_sort(members.begin(), members.end(), [](const Member &lhs, const Member &rhs) {
+		return lhs.name < rhs.name;
+	});
+
+	for (size_t i = 0; i < members.size(); ++i) {
+		if (i + 1 == members.size() || members[i].name != members[i + 1].name) {
+			members_.push_back(std::move(members[i]));
+		}
+	}
+}
+
+/*-----------------------------------------------------------------------------
+// Name: read_index
+// Desc: loads a saved index, returns false if there is none or it was built
+//       from a different bundle
+//---------------------------------------------------------------------------*/
+bool BundleIndex::read_index(const std::string &filename) {
+
+	std::ifstream is(filename, std::ifstream::binary);
+	if (!is) {
+		return false;
+	}
+
+	auto get = [&is](void *value, size_t size) {
+		return static_cast<bool>(is.read(static_cast<char *>(value), size));
+	};
+
+	char magic[sizeof(IndexMagic)];
+	Fingerprint fingerprint;
+	uint32_t count;
+
+	if (!get(magic, sizeof(magic)) || memcmp(magic, IndexMagic, sizeof(magic)) != 0) {
+		return false;
+	}
+
+	if (!get(&fingerprint.size, sizeof(fingerprint.size)) || !get(&fingerprint.mtime_sec, sizeof(fingerprint.mtime_sec)) ||
+		!get(&fingerprint.mtime_nsec, sizeof(fingerprint.mtime_nsec)) || !get(&fingerprint.head_crc, sizeof(fingerprint.head_crc)) ||
+		!get(&fingerprint.tail_crc, sizeof(fingerprint.tail_crc))) {
+		return false;
+	}
+
+	if (fingerprint.size != fingerprint_.size || fingerprint.mtime_sec != fingerprint_.mtime_sec || fingerprint.mtime_nsec != fingerprint_.mtime_nsec ||
+		fingerprint.head_crc != fingerprint_.head_crc || fingerprint.tail_crc != fingerprint_.tail_crc) {
+		return false;
+	}
+
+	std::vector<AccessPoint> points;
+	if (!get(&count, sizeof(count))) {
+		return false;
+	}
+
+	for (uint32_t i = 0; i < count; ++i) {
+		AccessPoint point;
+		uint32_t length;
+		if (!get(&point.out, sizeof(point.out)) || !get(&point.in, sizeof(point.in)) || !get(&point.bits, sizeof(point.bits)) ||
+			!get(&point.window_size, sizeof(point.window_size)) || !get(&length, sizeof(length))) {
+			return false;
+		}
+
+		if (point.bits > 7 || point.window_size > WindowSize || point.in > fingerprint_.size || length > compressBound(WindowSize)) {
+			return false;
+		}
+
+		point.window.resize(length);
+		if (!get(point.window.data(), length)) {
+			return false;
+		}
+
+		points.push_back(std::move(point));
+	}
+
+	std::vector<Member> members;
+	if (!get(&count, sizeof(count))) {
+		return false;
+	}
+
+	for (uint32_t i = 0; i < count; ++i) {
+		Member member;
+		uint32_t length;
+		if (!get(&member.offset, sizeof(member.offset)) || !get(&member.size, sizeof(member.size)) || !get(&length, sizeof(length))) {
+			return false;
+		}
+
+		if (length > 0x10000) {
+			return false;
+		}
+
+		member.name.resize(length);
+		if (!get(&member.name[0], length)) {
+			return false;
+		}
+
+		members.push_back(std::move(member));
+	}
+
+	if (points.empty() && !members.empty()) {
+		return false;
+	}
+
+	points_  = std::move(points);
+	members_ = std::move(members);
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+// Name: write
+//---------------------------------------------------------------------------*/
+void BundleIndex::write(const char *filename) const {
+
+	assert(filename != nullptr);
+
+	/* written under a unique name and renamed into place, so readers never
+	 * see a partial index and concurrent writers don't clobber each other */
+	const std::string target(filename);
+	std::vector<char> temp_name(target.c_str(), target.c_str() + target.size() + 1);
+	temp_name.insert(temp_name.end() - 1, {'.', 'X', 'X', 'X', 'X', 'X', 'X'});
+
+	const int fd = mkstemp(temp_name.data());
+	if (fd < 0) {
+		throw ines_open_failed();
+	}
+
+	const bool shared = fchmod(fd, 0644) == 0;
+	close(fd);
+
+	const std::string temp(temp_name.data());
+
+	try {
+		if (!shared) {
+			throw ines_write_failed();
+		}
+
+		std::ofstream os(temp, std::ofstream::binary);
+
+		if (!os) {
+			throw ines_open_failed();
+		}
+
+		auto put = [&os](const void *value, size_t size) {
+			os.write(static_cast<const char *>(value), size);
+		};
+
+		put(IndexMagic, sizeof(IndexMagic));
+		put(&fingerprint_.size, sizeof(fingerprint_.size));
+		put(&fingerprint_.mtime_sec, sizeof(fingerprint_.mtime_sec));
+		put(&fingerprint_.mtime_nsec, sizeof(fingerprint_.mtime_nsec));
+		put(&fingerprint_.head_crc, sizeof(fingerprint_.head_crc));
+		put(&fingerprint_.tail_crc, sizeof(fingerprint_.tail_crc));
+
+		const auto point_count = static_cast<uint32_t>(points_.size());
+		put(&point_count, sizeof(point_count));
+
+		for (const AccessPoint &point : points_) {
+			const auto length = static_cast<uint32_t>(point.window.size());
+			put(&point.out, sizeof(point.out));
+			put(&point.in, sizeof(point.in));
+			put(&point.bits, sizeof(point.bits));
+			put(&point.window_size, sizeof(point.window_size));
+			put(&length, sizeof(length));
+			put(point.window.data(), length);
+		}
+
+		const auto member_count = static_cast<uint32_t>(members_.size());
+		put(&member_count, sizeof(member_count));
+
+		for (const Member &member : members_) {
+			const auto length = static_cast<uint32_t>(member.name.size());
+			put(&member.offset, sizeof(member.offset));
+			put(&member.size, sizeof(member.size));
+			put(&length, sizeof(length));
+			put(member.name.data(), length);
+		}
+
+		os.close();
+		if (!os) {
+			throw ines_write_failed();
+		}
+	} catch (const ines_error &) {
+		unlink(temp.c_str());
+		throw;
+	}
+
+	if (rename(temp.c_str(), filename) != 0) {
+		unlink(temp.c_str());
+		throw ines_write_failed();
+	}
+}
+
+/*-----------------------------------------------------------------------------
+// Name: members
+//---------------------------------------------------------------------------*/
+const std::vector<BundleIndex::Member> &BundleIndex::members() const {
+	return members_;
+}
+
+/*-----------------------------------------------------------------------------
+// Name: find
+//---------------------------------------------------------------------------*/
+const BundleIndex::Member *BundleIndex::find(const std::string &name) const {
+
+	auto it = std::lower_bound(members_.begin(), members_.end(), name, [](const Member &member, const std::string &key) {
+		return member.name < key;
+	});
+
+	if (it == members_.end() || it->name != name) {
+		return nullptr;
+	}
+
+	return &*it;
+}
+
+/*-----------------------------------------------------------------------------
+// Name: read
+// Desc: inflates only from the closest access point before the member
+//---------------------------------------------------------------------------*/
+std::vector<uint8_t> BundleIndex::read(const Member &member) const {
+
+	std::vector<uint8_t> data(member.size);
+
+	if (member.size == 0) {
+		return data;
+	}
+
+	auto point = std::upper_bound(points_.begin(), points_.end(), member.offset, [](uint64_t offset, const AccessPoint &candidate) {
+		return offset < candidate.out;
+	});
+
+	assert(point != points_.begin());
+	--point;
+
+	File file = open_file(filename_);
+
+	if (fseeko(file.get(), static_cast<off_t>(point->in - (point->bits ? 1 : 0)), SEEK_SET) != 0) {
+		throw ines_read_failed();
+	}
+
+	Inflater inflater;
+	z_stream &strm = inflater.strm;
+
+	if (inflateInit2(&strm, -15) != Z_OK) {
+		throw ines_read_failed();
+	}
+
+	if (point->bits) {
+		const int ch = getc(file.get());
+		if (ch == EOF) {
+			throw ines_read_failed();
+		}
+		inflatePrime(&strm, point->bits, ch >> (8 - point->bits));
+	}
+
+	if (point->window_size != 0) {
+		std::vector<uint8_t> window(point->window_size);
+		uLongf length = point->window_size;
+
+		if (uncompress(window.data(), &length, point->window.data(), point->window.size()) != Z_OK || length != point->window_size) {
+			throw ines_corrupt_data();
+		}
+
+		inflateSetDictionary(&strm, window.data(), point->window_size);
+	}
+
+	auto input   = std::make_unique<uint8_t[]>(ChunkSize);
+	auto scratch = std::make_unique<uint8_t[]>(WindowSize);
+
+	uint64_t skip  = member.offset - point->out;
+	size_t filled  = 0;
+	size_t trailer = 0;
+	bool raw       = true;
+
+	while (filled < data.size()) {
+		if (!fill_input(strm, file.get(), input.get())) {
+			throw ines_read_failed();
+		}
+
+		/* a raw deflate stream ends where its gzip member does, after
+		 * which the rest of the bundle is read as gzip again */
+		if (trailer != 0) {
+			const size_t count = std::min<size_t>(trailer, strm.avail_in);
+			strm.next_in += count;
+			strm.avail_in -= static_cast<uInt>(count);
+			trailer -= count;
+			if (trailer == 0) {
+				inflateReset2(&strm, 31);
+			}
+			continue;
+		}
+
+		if (skip != 0) {
+			strm.next_out  = scratch.get();
+			strm.avail_out = static_cast<uInt>(std::min<uint64_t>(skip, WindowSize));
+		} else {
+			strm.next_out  = data.data() + filled;
+			strm.avail_out = static_cast<uInt>(std::min<size_t>(data.size() - filled, 0x40000000));
+		}
+
+		uint8_t *const out = strm.next_out;
+		const int ret      = inflate(&strm, Z_NO_FLUSH);
+		const size_t count = strm.next_out - out;
+
+		if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+			throw ines_corrupt_data();
+		}
+
+		if (skip != 0) {
+			skip -= count;
+		} else {
+			filled += count;
+		}
+
+		if (ret == Z_STREAM_END) {
+			if (raw) {
+				trailer = TrailerSize;
+				raw     = false;
+			} else {
+				inflateReset(&strm);
+			}
+		}
+	}
+
+	return data;
+}
+
+/*-----------------------------------------------------------------------------
+// Name: load
+//---------------------------------------------------------------------------*/
+Rom BundleIndex::load(const std::string &name) const {
+
+	const Member *member = find(name);
+	if (!member) {
+		throw ines_open_failed();
+	}
+
+	const std::vector<uint8_t> data = read(*member);
+	return Rom(data.data(), data.size());
+}
+
+}
@@ -0,0 +1,251 @@
+/*
+Copyright (C) 2000 - 2016 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "iNES/BundleReader.h"
+#include "iNES/Error.h"
+#include "iNES/Rom.h"
+#include "Tar.h"
+
+#include <cassert>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef ZLIB_NOT_FOUND
+#include <zlib.h>
+#endif
+
+namespace iNES {
+namespace {
+
+constexpr size_t ChunkSize       = 0x40000;
+constexpr uint64_t MaxMemberSize = 0x10000000;
+
+struct Item {
+	std::string name;
+	std::vector<uint8_t> data;
+	bool oversized;
+};
+
+/* bounded queue between the decompression and loading stages */
+class Pipeline {
+public:
+	explicit Pipeline(size_t depth)
+		: depth_(depth ? depth : 1) {
+	}
+
+public:
+	/* returns false once the pipeline has been cancelled */
+	bool push(Item &&item) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		not_full_.wait(lock, [this] { return cancelled_ || items_.size() < depth_; });
+		if (cancelled_) {
+			return false;
+		}
+
+		items_.push_back(std::move(item));
+		not_empty_.notify_one();
+		return true;
+	}
+
+	/* returns false once the producer is done and everything has been taken */
+	bool pop(Item &item) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		not_empty_.wait(lock, [this] { return finished_ || !items_.empty(); });
+		if (items_.empty()) {
+			return false;
+		}
+
+		item = std::move(items_.front());
+		items_.pop_front();
+		not_full_.notify_one();
+		return true;
+	}
+
+	void finish(std::exception_ptr error) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		finished_ = true;
+		error_    = error;
+		not_empty_.notify_all();
+	}
+
+	void cancel() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		cancelled_ = true;
+		not_full_.notify_all();
+	}
+
+	std::exception_ptr error() const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return error_;
+	}
+
+private:
+	mutable std::mutex mutex_;
+	std::condition_variable not_empty_;
+	std::condition_variable not_full_;
+	std::deque<Item> items_;
+	size_t depth_;
+	bool finished_  = false;
+	bool cancelled_ = false;
+	std::exception_ptr error_;
+};
+
+/*------------------------------------------------------------------------------
+// Name: decompress
+// Desc: the producer stage, splits the bundle into members
+//----------------------------------------------------------------------------*/
+void decompress(const char *filename, Pipeline &pipeline) {
+
+	Item current;
+	uint64_t expected = 0;
+	bool collecting   = false;
+	bool stopped      = false;
+
+	TarParser tar(
+		[&](const std::string &name, uint64_t offset, uint64_t size) {
+			(void)offset;
+			collecting = false;
+
+			if (size > MaxMemberSize) {
+				stopped = !pipeline.push(Item{name, {}, true});
+				return;
+			}
+
+			current = Item{name, {}, false};
+			current.data.reserve(size);
+			expected = size;
+
+			if (size == 0) {
+				stopped = !pipeline.push(std::move(current));
+			} else {
+				collecting = true;
+			}
+		},
+		[&](const uint8_t *data, size_t size) {
+			if (!collecting || stopped) {
+				return;
+			}
+
+			current.data.insert(current.data.end(), data, data + size);
+			if (current.data.size() == expected) {
+				collecting = false;
+				stopped    = !pipeline.push(std::move(current));
+			}
+		});
+
+#ifndef ZLIB_NOT_FOUND
+	/* gzread reads plain files as they are, so this covers .tar as well */
+	std::unique_ptr<gzFile_s, int (*)(gzFile)> file(gzopen(filename, "rb"), gzclose);
+#else
+	std::unique_ptr<FILE, int (*)(FILE *)> file(fopen(filename, "rb"), fclose);
+#endif
+	if (!file) {
+		throw ines_open_failed();
+	}
+
+	auto buffer = std::make_unique<uint8_t[]>(ChunkSize);
+
+	while (!tar.finished() && !stopped) {
+#ifndef ZLIB_NOT_FOUND
+		const int count = gzread(file.get(), buffer.get(), ChunkSize);
+		if (count < 0) {
+			throw ines_read_failed();
+		}
+#else
+		const size_t count = fread(buffer.get(), 1, ChunkSize, file.get());
+		if (ferror(file.get())) {
+			throw ines_read_failed();
+		}
+#endif
+		if (count == 0) {
+			break;
+		}
+
+		tar.feed(buffer.get(), static_cast<size_t>(count));
+	}
+
+	/* archives missing their end marker are tolerated, truncated members are not */
+	if (collecting && !stopped) {
+		throw ines_bad_archive();
+	}
+}
+
+}
+
+/*-----------------------------------------------------------------------------
+// Name: read_bundle
+//---------------------------------------------------------------------------*/
+void read_bundle(const char *filename, const RomConsumer &consumer, const ErrorHandler &on_error, size_t queue_depth) {
+
+	assert(filename != nullptr);
+
+	Pipeline pipeline(queue_depth);
+
+	std::thread producer([filename, &pipeline]() {
+		try {
+			decompress(filename, pipeline);
+			pipeline.finish(nullptr);
+		} catch (...) {
+			pipeline.finish(std::current_exception());
+		}
+	});
+
+	try {
+		Item item;
+		while (pipeline.pop(item)) {
+			if (item.oversized) {
+				if (on_error) {
+					on_error(item.name, ines_unsupported_file_type());
+				}
+				continue;
+			}
+
+			std::unique_ptr<Rom> rom;
+			try {
+				rom = std::make_unique<Rom>(item.data.data(), item.data.size());
+			} catch (const ines_error &e) {
+				if (on_error) {
+					on_error(item.name, e);
+				}
+				continue;
+			}
+
+			/* the raw member isn't needed now that it's been loaded */
+			std::vector<uint8_t>().swap(item.data);
+			consumer(item.name, *rom);
+		}
+	} catch (...) {
+		pipeline.cancel();
+		producer.join();
+		throw;
+	}
+
+	producer.join();
+
+	if (std::exception_ptr error = pipeline.error()) {
+		std::rethrow_exception(error);
+	}
+}
+
+}
@@ -0,0 +1,250 @@
+/*
+Copyright (C) 2000 - 2016 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "iNES/CompressedRom.h"
+#include "iNES/Error.h"
+#include "iNES/Rom.h"
+
+#include <cstring>
+
+#ifndef ZLIB_NOT_FOUND
+#include <zlib.h>
+#endif
+
+namespace iNES {
+namespace {
+
+constexpr uint32_t PrgSection = 0;
+constexpr uint32_t ChrSection = 1;
+
+/*------------------------------------------------------------------------------
+// Name: compress_bank
+// Desc: a bank which does not shrink is stored as is, which is recognized on
+//       the way out by its length being the full bank size
+//----------------------------------------------------------------------------*/
+std::vector<uint8_t> compress_bank(const uint8_t *data, size_t size) {
+#ifndef ZLIB_NOT_FOUND
+	uLongf length = compressBound(size);
+	std::vector<uint8_t> packed(length);
+
+	if (compress2(packed.data(), &length, data, size, Z_BEST_SPEED) == Z_OK && length < size) {
+		packed.resize(length);
+		packed.shrink_to_fit();
+		return packed;
+	}
+#endif
+	return std::vector<uint8_t>(data, data + size);
+}
+
+/*------------------------------------------------------------------------------
+// Name: decompress_bank
+//----------------------------------------------------------------------------*/
+std::vector<uint8_t> decompress_bank(const std::vector<uint8_t> &packed, size_t size) {
+
+	if (packed.size() == size) {
+		return packed;
+	}
+
+#ifndef ZLIB_NOT_FOUND
+	std::vector<uint8_t> bank(size);
+	uLongf length = size;
+
+	if (uncompress(bank.data(), &length, packed.data(), packed.size()) != Z_OK || length != size) {
+		throw ines_corrupt_data();
+	}
+
+	return bank;
+#else
+	throw ines_corrupt_data();
+#endif
+}
+
+/*------------------------------------------------------------------------------
+// Name: compress_section
+//----------------------------------------------------------------------------*/
+std::vector<std::vector<uint8_t>> compress_section(const uint8_t *data, uint32_t size, uint32_t bank_size) {
+
+	std::vector<std::vector<uint8_t>> banks;
+	for (uint32_t offset = 0; offset < size; offset += bank_size) {
+		banks.push_back(compress_bank(data + offset, bank_size));
+	}
+
+	return banks;
+}
+
+}
+
+/*-----------------------------------------------------------------------------
+// Name: CompressedRom
+//---------------------------------------------------------------------------*/
+CompressedRom::CompressedRom(const Rom &rom, size_t hot_banks)
+	: header_(*rom.header()), prg_size_(rom.prg_size()), chr_size_(rom.chr_size()), hot_banks_(hot_banks) {
+
+	if (rom.trainer()) {
+		trainer_ = std::make_unique<uint8_t[]>(TrainerSize);
+		memcpy(trainer_.get(), rom.trainer(), TrainerSize);
+	}
+
+	prg_banks_ = compress_section(rom.prg_rom(), prg_size_, PrgBlockSize);
+	chr_banks_ = compress_section(rom.chr_rom(), chr_size_, ChrBlockSize);
+}
+
+/*-----------------------------------------------------------------------------
+// Name: bank
+//---------------------------------------------------------------------------*/
+CompressedRom::Bank CompressedRom::bank(uint32_t section, uint32_t index) {
+
+	const auto &banks        = (section == PrgSection) ? prg_banks_ : chr_banks_;
+	const uint32_t bank_size = (section == PrgSection) ? PrgBlockSize : ChrBlockSize;
+
+	if (index >= banks.size()) {
+		throw ines_bad_bank();
+	}
+
+	const uint64_t key = (static_cast<uint64_t>(section) << 32) | index;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		auto it = hot_.find(key);
+		if (it != hot_.end()) {
+			++hits_;
+			lru_.splice(lru_.begin(), lru_, it->second.lru);
+			return it->second.bank;
+		}
+
+		++misses_;
+	}
+
+	/* the compressed banks never change, so other sessions can keep hitting
+	 * the hot set while this one decompresses */
+	Bank bank = std::make_shared<const std::vector<uint8_t>>(decompress_bank(banks[index], bank_size));
+
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	/* another thread may have brought the same bank in meanwhile */
+	auto it = hot_.find(key);
+	if (it != hot_.end()) {
+		lru_.splice(lru_.begin(), lru_, it->second.lru);
+		return it->second.bank;
+	}
+
+	if (hot_banks_ != 0) {
+		if (hot_.size() >= hot_banks_) {
+			hot_.erase(lru_.back());
+			lru_.pop_back();
+		}
+
+		lru_.push_front(key);
+		hot_.emplace(key, Entry{bank, lru_.begin()});
+	}
+
+	return bank;
+}
+
+/*-----------------------------------------------------------------------------
+// Name: prg_bank
+//---------------------------------------------------------------------------*/
+CompressedRom::Bank CompressedRom::prg_bank(uint32_t index) {
+	return bank(PrgSection, index);
+}
+
+/*-----------------------------------------------------------------------------
+// Name: chr_bank
+//---------------------------------------------------------------------------*/
+CompressedRom::Bank CompressedRom::chr_bank(uint32_t index) {
+	return bank(ChrSection, index);
+}
+
+/*-----------------------------------------------------------------------------
+// Name: hits
+//---------------------------------------------------------------------------*/
+uint64_t CompressedRom::hits() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return hits_;
+}
+
+/*-----------------------------------------------------------------------------
+// Name: misses
+//---------------------------------------------------------------------------*/
+uint64_t CompressedRom::misses() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return misses_;
+}
+
+/*-----------------------------------------------------------------------------
+// Name: compressed_size
+// Desc: bytes held by the compressed PRG and CHR banks
+//---------------------------------------------------------------------------*/
+size_t CompressedRom::compressed_size() const {
+
+	size_t size = 0;
+	for (const auto &bank : prg_banks_) {
+		size += bank.size();
+	}
+
+	for (const auto &bank : chr_banks_) {
+		size += bank.size();
+	}
+
+	return size;
+}
+
+/*-----------------------------------------------------------------------------
+// Name: header
+//---------------------------------------------------------------------------*/
+const Header *CompressedRom::header() const {
+	return &header_;
+}
+
+/*-----------------------------------------------------------------------------
+// Name: trainer
+//---------------------------------------------------------------------------*/
+const uint8_t *CompressedRom::trainer() const {
+	return trainer_.get();
+}
+
+/*-----------------------------------------------------------------------------
+// Name: prg_size
+//---------------------------------------------------------------------------*/
+uint32_t CompressedRom::prg_size() const {
+	return prg_size_;
+}
+
+/*-----------------------------------------------------------------------------
+// Name: chr_size
+//---------------------------------------------------------------------------*/
+uint32_t CompressedRom::chr_size() const {
+	return chr_size_;
+}
+
+/*-----------------------------------------------------------------------------
+// Name: prg_banks
+//---------------------------------------------------------------------------*/
+uint32_t CompressedRom::prg_banks() const {
+	return static_cast<uint32_t>(prg_banks_.size());
+}
+
+/*-----------------------------------------------------------------------------
+// Name: chr_banks
+//---------------------------------------------------------------------------*/
+uint32_t CompressedRom::chr_banks() const {
+	return static_cast<uint32_t>(chr_banks_.size());
+}
+
+}
@@ -0,0 +1,36 @@
+/*
+Copyright (C) 2000 - 2016 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INES_CRC32_20261019_H_
+#define INES_CRC32_20261019_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace iNES {
+
+/* data smaller than this is always hashed on the calling thread */
+constexpr size_t ParallelHashThreshold = 0x100000;
+
+uint32_t ines_crc32(const void *data, size_t length, uint32_t initial_value);
+uint32_t ines_crc32_combine(uint32_t crc1, uint32_t crc2, size_t length2);
+uint32_t ines_crc32_parallel(const void *data, size_t length, uint32_t initial_value, unsigned int threads);
+
+}
+
+#endif
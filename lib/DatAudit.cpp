@@ -0,0 +1,112 @@
+/*
+Copyright (C) 2000 - 2016 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "iNES/DatAudit.h"
+#include "iNES/Header.h"
+#include "iNES/Rom.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace iNES {
+namespace {
+
+/*------------------------------------------------------------------------------
+// Name: digest_matches
+// Desc: a digest missing from either side doesn't count against a match
+//----------------------------------------------------------------------------*/
+bool digest_matches(const uint8_t *expected, const uint8_t *actual, size_t size) {
+
+	if (actual == nullptr || std::all_of(expected, expected + size, [](uint8_t ch) { return ch == 0; })) {
+		return true;
+	}
+
+	return memcmp(expected, actual, size) == 0;
+}
+
+}
+
+/*-----------------------------------------------------------------------------
+// Name: DatAudit
+//---------------------------------------------------------------------------*/
+DatAudit::DatAudit(const DatIndex &index)
+	: index_(index), seen_(index.entries().size(), false) {
+}
+
+/*-----------------------------------------------------------------------------
+// Name: add
+//---------------------------------------------------------------------------*/
+DatStatus DatAudit::add(const std::string &filename, const Rom &rom) {
+
+	const uint32_t size = (rom.trainer() ? TrainerSize : 0) + rom.prg_size() + rom.chr_size();
+	return add(filename, *rom.header(), rom.rom_hash(), size);
+}
+
+/*-----------------------------------------------------------------------------
+// Name: add
+// Desc: crc and size are of the header-less ROM (trainer, PRG and CHR), as
+//       produced by Rom::rom_hash, and so are the digests when given
+//---------------------------------------------------------------------------*/
+DatStatus DatAudit::add(const std::string &filename, const Header &header, uint32_t crc, uint32_t size, const uint8_t *md5, const uint8_t *sha1) {
+
+	const auto range = index_.find(crc, size);
+
+	const DatIndex::Entry *match = nullptr;
+	for (auto it = range.first; it != range.second; ++it) {
+		if (digest_matches(it->md5, md5, sizeof(it->md5)) && digest_matches(it->sha1, sha1, sizeof(it->sha1))) {
+			seen_[it - index_.entries().begin()] = true;
+			if (!match) {
+				match = &*it;
+			}
+		}
+	}
+
+	if (!match) {
+		results_.push_back(Result{filename, DatStatus::UNKNOWN, nullptr});
+		return DatStatus::UNKNOWN;
+	}
+
+	const DatStatus status = header.isDirty() ? DatStatus::BAD_HEADER : DatStatus::MATCHED;
+	results_.push_back(Result{filename, status, match});
+	return status;
+}
+
+/*-----------------------------------------------------------------------------
+// Name: results
+//---------------------------------------------------------------------------*/
+const std::vector<DatAudit::Result> &DatAudit::results() const {
+	return results_;
+}
+
+/*-----------------------------------------------------------------------------
+// Name: missing
+// Desc: entries of the DAT which no ROM added so far has matched
+//---------------------------------------------------------------------------*/
+std::vector<const DatIndex::Entry *> DatAudit::missing() const {
+
+	std::vector<const DatIndex::Entry *> entries;
+	for (size_t i = 0; i < seen_.size(); ++i) {
+		if (!seen_[i]) {
+			entries.push_back(&index_.entries()[i]);
+		}
+	}
+
+	return entries;
+}
+
+}
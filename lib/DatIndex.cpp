@@ -0,0 +1,376 @@
+/*
+Copyright (C) 2000 - 2016 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "iNES/DatIndex.h"
+#include "iNES/Error.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace iNES {
+namespace {
+
+constexpr char IndexMagic[8] = {'i', 'N', 'E', 'S', 'D', 'A', 'T', '1'};
+
+using Attributes = std::vector<std::pair<std::string, std::string>>;
+
+/*------------------------------------------------------------------------------
+// Name: decode_entities
+//----------------------------------------------------------------------------*/
+std::string decode_entities(const std::string &text) {
+
+	std::string result;
+	result.reserve(text.size());
+
+	for (size_t i = 0; i < text.size(); ++i) {
+		if (text[i] != '&') {
+			result += text[i];
+			continue;
+		}
+
+		const size_t end = text.find(';', i);
+		if (end == std::string::npos) {
+			result += text[i];
+			continue;
+		}
+
+		const std::string entity = text.substr(i + 1, end - i - 1);
+		if (entity == "amp") {
+			result += '&';
+		} else if (entity == "lt") {
+			result += '<';
+		} else if (entity == "gt") {
+			result += '>';
+		} else if (entity == "quot") {
+			result += '"';
+		} else if (entity == "apos") {
+			result += '\'';
+		} else if (entity.size() > 1 && entity[0] == '#') {
+			const bool hex  = entity[1] == 'x' || entity[1] == 'X';
+			const auto code = strtoul(entity.c_str() + (hex ? 2 : 1), nullptr, hex ? 16 : 10);
+
+			/* encode as UTF-8 */
+			if (code < 0x80) {
+				result += static_cast<char>(code);
+			} else if (code < 0x800) {
+				result += static_cast<char>(0xc0 | (code >> 6));
+				result += static_cast<char>(0x80 | (code & 0x3f));
+			} else if (code < 0x10000) {
+				result += static_cast<char>(0xe0 | (code >> 12));
+				result += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+				result += static_cast<char>(0x80 | (code & 0x3f));
+			} else {
+				result += static_cast<char>(0xf0 | (code >> 18));
+				result += static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+				result += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+				result += static_cast<char>(0x80 | (code & 0x3f));
+			}
+		} else {
+			result += text.substr(i, end - i + 1);
+		}
+
+		i = end;
+	}
+
+	return result;
+}
+
+/*------------------------------------------------------------------------------
+// Name: parse_attributes
+// Desc: parses the name="value" pairs of a tag between first and last
+//----------------------------------------------------------------------------*/
+Attributes parse_attributes(const std::string &xml, size_t first, size_t last) {
+
+	Attributes attributes;
+
+	size_t pos = first;
+	while (pos < last) {
+		const size_t name_start = xml.find_first_not_of(" \t\r\n/", pos);
+		if (name_start == std::string::npos || name_start >= last) {
+			break;
+		}
+
+		const size_t equals = xml.find('=', name_start);
+		if (equals == std::string::npos || equals >= last) {
+			break;
+		}
+
+		const size_t quote = xml.find_first_of("\"'", equals);
+		if (quote == std::string::npos || quote >= last) {
+			throw ines_bad_dat();
+		}
+
+		const size_t value_end = xml.find(xml[quote], quote + 1);
+		if (value_end == std::string::npos || value_end >= last) {
+			throw ines_bad_dat();
+		}
+
+		std::string name = xml.substr(name_start, equals - name_start);
+		name.erase(name.find_last_not_of(" \t\r\n") + 1);
+
+		attributes.emplace_back(std::move(name), decode_entities(xml.substr(quote + 1, value_end - quote - 1)));
+		pos = value_end + 1;
+	}
+
+	return attributes;
+}
+
+/*------------------------------------------------------------------------------
+// Name: attribute
+//----------------------------------------------------------------------------*/
+std::string attribute(const Attributes &attributes, const char *name) {
+
+	for (const auto &attr : attributes) {
+		if (attr.first == name) {
+			return attr.second;
+		}
+	}
+
+	return std::string();
+}
+
+/*------------------------------------------------------------------------------
+// Name: parse_hex
+// Desc: fills digest from a hex string, leaving it zeroed if the string is not
+//       a digest of the expected size
+//----------------------------------------------------------------------------*/
+void parse_hex(const std::string &text, uint8_t *digest, size_t size) {
+
+	memset(digest, 0, size);
+
+	if (text.size() != size * 2 || text.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) {
+		return;
+	}
+
+	for (size_t i = 0; i < size; ++i) {
+		digest[i] = static_cast<uint8_t>(strtoul(text.substr(i * 2, 2).c_str(), nullptr, 16));
+	}
+}
+
+/*------------------------------------------------------------------------------
+// Name: entry_less
+//----------------------------------------------------------------------------*/
+bool entry_less(const DatIndex::Entry &lhs, const DatIndex::Entry &rhs) {
+	return lhs.crc != rhs.crc ? lhs.crc < rhs.crc : lhs.size < rhs.size;
+}
+
+}
+
+/*-----------------------------------------------------------------------------
+// Name: DatIndex
+//---------------------------------------------------------------------------*/
+DatIndex::DatIndex(const char *filename) {
+
+	assert(filename != nullptr);
+
+	std::ifstream is(filename, std::ifstream::binary);
+
+	if (!is) {
+		throw ines_open_failed();
+	}
+
+	const std::string data((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+
+	if (is.bad()) {
+		throw ines_read_failed();
+	}
+
+	if (data.compare(0, sizeof(IndexMagic), IndexMagic, sizeof(IndexMagic)) != 0) {
+		parse(data);
+		return;
+	}
+
+	/* a compiled index: magic, entry count, string table size, entries, strings */
+	uint32_t count;
+	uint32_t strings_size;
+	size_t offset = sizeof(IndexMagic);
+
+	if (data.size() < offset + sizeof(count) + sizeof(strings_size)) {
+		throw ines_bad_dat();
+	}
+
+	memcpy(&count, data.data() + offset, sizeof(count));
+	offset += sizeof(count);
+	memcpy(&strings_size, data.data() + offset, sizeof(strings_size));
+	offset += sizeof(strings_size);
+
+	if (data.size() != offset + static_cast<size_t>(count) * sizeof(Entry) + strings_size) {
+		throw ines_bad_dat();
+	}
+
+	entries_.resize(count);
+	memcpy(entries_.data(), data.data() + offset, count * sizeof(Entry));
+	strings_ = data.substr(offset + count * sizeof(Entry));
+
+	for (const Entry &entry : entries_) {
+		if (entry.game >= strings_.size() || entry.rom >= strings_.size()) {
+			throw ines_bad_dat();
+		}
+	}
+
+	if (strings_.empty() || strings_.back() != '\0' || !std::is_sorted(entries_.begin(), entries_.end(), entry_less)) {
+		throw ines_bad_dat();
+	}
+}
+
+/*-----------------------------------------------------------------------------
+// Name: parse
+// Desc: collects the <rom> entries of a logiqx XML DAT, only the tags and
+//       attributes the index needs are looked at
+//---------------------------------------------------------------------------*/
+void DatIndex::parse(const std::string &xml) {
+
+	uint32_t game = intern(std::string());
+	size_t pos    = 0;
+
+	while ((pos = xml.find('<', pos)) != std::string::npos) {
+
+		if (xml.compare(pos, 4, "<!--") == 0) {
+			pos = xml.find("-->", pos);
+			if (pos == std::string::npos) {
+				throw ines_bad_dat();
+			}
+			continue;
+		}
+
+		const size_t name_end = xml.find_first_of(" \t\r\n/>", pos + 1);
+		if (name_end == std::string::npos) {
+			throw ines_bad_dat();
+		}
+
+		/* find the end of the tag, '>' is allowed inside of quoted values */
+		size_t end = name_end;
+		char quote = 0;
+		for (; end < xml.size(); ++end) {
+			const char ch = xml[end];
+			if (quote != 0) {
+				if (ch == quote) {
+					quote = 0;
+				}
+			} else if (ch == '"' || ch == '\'') {
+				quote = ch;
+			} else if (ch == '>') {
+				break;
+			}
+		}
+
+		if (end == xml.size()) {
+			throw ines_bad_dat();
+		}
+
+		const std::string tag = xml.substr(pos + 1, name_end - pos - 1);
+
+		if (tag == "game" || tag == "machine") {
+			game = intern(attribute(parse_attributes(xml, name_end, end), "name"));
+		} else if (tag == "rom") {
+			const Attributes attributes = parse_attributes(xml, name_end, end);
+			const std::string crc       = attribute(attributes, "crc");
+
+			/* entries such as status="nodump" have nothing to match against */
+			if (!crc.empty()) {
+				Entry entry;
+				entry.crc  = static_cast<uint32_t>(strtoul(crc.c_str(), nullptr, 16));
+				entry.size = static_cast<uint32_t>(strtoul(attribute(attributes, "size").c_str(), nullptr, 10));
+				entry.game = game;
+				entry.rom  = intern(attribute(attributes, "name"));
+				parse_hex(attribute(attributes, "md5"), entry.md5, sizeof(entry.md5));
+				parse_hex(attribute(attributes, "sha1"), entry.sha1, sizeof(entry.sha1));
+				entries_.push_back(entry);
+			}
+		}
+
+		pos = end + 1;
+	}
+
+	std::stable_sort(entries_.begin(), entries_.end(), entry_less);
+}
+
+/*-----------------------------------------------------------------------------
+// Name: intern
+//---------------------------------------------------------------------------*/
+uint32_t DatIndex::intern(const std::string &s) {
+	const auto offset = static_cast<uint32_t>(strings_.size());
+	strings_.append(s.c_str(), s.size() + 1);
+	return offset;
+}
+
+/*-----------------------------------------------------------------------------
+// Name: write
+//---------------------------------------------------------------------------*/
+void DatIndex::write(const char *filename) const {
+
+	assert(filename != nullptr);
+
+	std::ofstream os(filename, std::ofstream::binary);
+
+	if (!os) {
+		throw ines_open_failed();
+	}
+
+	const auto count        = static_cast<uint32_t>(entries_.size());
+	const auto strings_size = static_cast<uint32_t>(strings_.size());
+
+	os.write(IndexMagic, sizeof(IndexMagic));
+	os.write(reinterpret_cast<const char *>(&count), sizeof(count));
+	os.write(reinterpret_cast<const char *>(&strings_size), sizeof(strings_size));
+	os.write(reinterpret_cast<const char *>(entries_.data()), entries_.size() * sizeof(Entry));
+	os.write(strings_.data(), strings_.size());
+
+	if (!os) {
+		throw ines_write_failed();
+	}
+}
+
+/*-----------------------------------------------------------------------------
+// Name: find
+// Desc: returns the range of entries with the given CRC32 and size, several
+//       games can share the same ROM
+//---------------------------------------------------------------------------*/
+std::pair<DatIndex::const_iterator, DatIndex::const_iterator> DatIndex::find(uint32_t crc, uint32_t size) const {
+	Entry key = {};
+	key.crc   = crc;
+	key.size  = size;
+	return std::equal_range(entries_.begin(), entries_.end(), key, entry_less);
+}
+
+/*-----------------------------------------------------------------------------
+// Name: entries
+//---------------------------------------------------------------------------*/
+const std::vector<DatIndex::Entry> &DatIndex::entries() const {
+	return entries_;
+}
+
+/*-----------------------------------------------------------------------------
+// Name: game_name
+//---------------------------------------------------------------------------*/
+const char *DatIndex::game_name(const Entry &entry) const {
+	return strings_.c_str() + entry.game;
+}
+
+/*-----------------------------------------------------------------------------
+// Name: rom_name
+//---------------------------------------------------------------------------*/
+const char *DatIndex::rom_name(const Entry &entry) const {
+	return strings_.c_str() + entry.rom;
+}
+
+}
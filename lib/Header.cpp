@@ -31,6 +31,17 @@ constexpr int INES_SRAM    = 0x02;
 constexpr int INES_TRAINER = 0x04;
 constexpr int INES_4SCREEN = 0x08;
 
+/* RAM size assumed for iNES 1.0 headers, which don't say */
+constexpr uint32_t DefaultRamSize = 0x2000;
+
+/*------------------------------------------------------------------------------
+// Name: ram_size
+// Desc: NES 2.0 RAM sizes are shift counts, 0 meaning none
+//----------------------------------------------------------------------------*/
+uint32_t ram_size(uint8_t shift) {
+	return shift ? (64u << shift) : 0;
+}
+
 }
 
 /*-----------------------------------------------------------------------------
@@ -217,4 +228,63 @@ uint32_t Header::chr_size() const {
 	}
 }
 
+/*-----------------------------------------------------------------------------
+// Name: battery_present
+//---------------------------------------------------------------------------*/
+bool Header::battery_present() const {
+	return ((ctrl1_ & INES_SRAM) != 0);
+}
+
+/*-----------------------------------------------------------------------------
+// Name: prg_ram_size
+//---------------------------------------------------------------------------*/
+uint32_t Header::prg_ram_size() const {
+
+	switch (version()) {
+	case 2:
+		return ram_size(extended_.ines2.byte10 & 0x0f);
+	default:
+		return battery_present() ? 0 : DefaultRamSize;
+	}
+}
+
+/*-----------------------------------------------------------------------------
+// Name: prg_nvram_size
+//---------------------------------------------------------------------------*/
+uint32_t Header::prg_nvram_size() const {
+
+	switch (version()) {
+	case 2:
+		return ram_size((extended_.ines2.byte10 & 0xf0) >> 4);
+	default:
+		return battery_present() ? DefaultRamSize : 0;
+	}
+}
+
+/*-----------------------------------------------------------------------------
+// Name: chr_ram_size
+//---------------------------------------------------------------------------*/
+uint32_t Header::chr_ram_size() const {
+
+	switch (version()) {
+	case 2:
+		return ram_size(extended_.ines2.byte11 & 0x0f);
+	default:
+		return (chr_size() == 0) ? DefaultRamSize : 0;
+	}
+}
+
+/*-----------------------------------------------------------------------------
+// Name: chr_nvram_size
+//---------------------------------------------------------------------------*/
+uint32_t Header::chr_nvram_size() const {
+
+	switch (version()) {
+	case 2:
+		return ram_size((extended_.ines2.byte11 & 0xf0) >> 4);
+	default:
+		return 0;
+	}
+}
+
 }
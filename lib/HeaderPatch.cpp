@@ -0,0 +1,644 @@
+/*
+Copyright (C) 2000 - 2016 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "iNES/HeaderPatch.h"
+#include "iNES/Error.h"
+#include "Crc32.h"
+
+#include <cassert>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#ifndef ZLIB_NOT_FOUND
+#include <zlib.h>
+#endif
+
+namespace iNES {
+namespace {
+
+constexpr char JournalSuffix[] = ".hdr-journal";
+constexpr char JournalMagic[8] = {'i', 'N', 'E', 'S', 'J', 'R', 'N', '1'};
+constexpr char CopyJournalMagic[8] = {'i', 'N', 'E', 'S', 'J', 'C', 'P', '1'};
+constexpr size_t MaxPatchSize  = 32;
+constexpr size_t CopyChunkSize = 0x10000;
+
+/* a gzip member holding just the iNES header in a stored deflate block. it
+ * has a fixed size, so the header can be replaced in place along with the
+ * member's CRC: gzip header, final stored block of 16 bytes, data, CRC32, size */
+constexpr uint8_t StoredPrefix[] = {
+	0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff,
+	0x01, 0x10, 0x00, 0xef, 0xff};
+
+constexpr size_t StoredDataOffset = sizeof(StoredPrefix);
+constexpr size_t StoredMemberSize = sizeof(StoredPrefix) + sizeof(Header) + 8;
+
+/* owns a file descriptor */
+class Descriptor {
+public:
+	explicit Descriptor(int fd)
+		: fd_(fd) {
+	}
+
+	Descriptor(const Descriptor &) = delete;
+	Descriptor &operator=(const Descriptor &) = delete;
+
+	~Descriptor() {
+		if (fd_ >= 0) {
+			close(fd_);
+		}
+	}
+
+	int get() const {
+		return fd_;
+	}
+
+private:
+	int fd_;
+};
+
+/*------------------------------------------------------------------------------
+// Name: read_at
+//----------------------------------------------------------------------------*/
+bool read_at(int fd, void *buffer, size_t size, off_t offset) {
+
+	auto *ptr = static_cast<uint8_t *>(buffer);
+	while (size != 0) {
+		const ssize_t count = pread(fd, ptr, size, offset);
+		if (count < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (count <= 0) {
+			return false;
+		}
+
+		ptr += count;
+		size -= count;
+		offset += count;
+	}
+
+	return true;
+}
+
+/*------------------------------------------------------------------------------
+// Name: write_at
+//----------------------------------------------------------------------------*/
+void write_at(int fd, const void *buffer, size_t size, off_t offset) {
+
+	const auto *ptr = static_cast<const uint8_t *>(buffer);
+	while (size != 0) {
+		const ssize_t count = pwrite(fd, ptr, size, offset);
+		if (count < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (count <= 0) {
+			throw ines_write_failed();
+		}
+
+		ptr += count;
+		size -= count;
+		offset += count;
+	}
+}
+
+/*------------------------------------------------------------------------------
+// Name: sync_fd
+//----------------------------------------------------------------------------*/
+void sync_fd(int fd) {
+	if (fsync(fd) != 0) {
+		throw ines_write_failed();
+	}
+}
+
+/*------------------------------------------------------------------------------
+// Name: sync_directory
+// Desc: makes a rename within the directory of filename durable
+//----------------------------------------------------------------------------*/
+void sync_directory(const std::string &filename) {
+
+	const size_t slash = filename.find_last_of('/');
+	const std::string directory = (slash == std::string::npos) ? "." : filename.substr(0, slash + 1);
+
+	Descriptor fd(open(directory.c_str(), O_RDONLY));
+	if (fd.get() >= 0) {
+		sync_fd(fd.get());
+	}
+}
+
+/*------------------------------------------------------------------------------
+// Name: patch_bytes
+// Desc: the journal records where the bytes go and what they were, so that
+//       recover_header can finish the write after a crash
+//----------------------------------------------------------------------------*/
+void patch_bytes(const std::string &filename, int fd, uint32_t offset, const uint8_t *old_bytes, const uint8_t *new_bytes, uint32_t size, const PatchOptions &options) {
+
+	assert(size <= MaxPatchSize);
+
+	const std::string journal = filename + JournalSuffix;
+
+	if (options.journal) {
+		Descriptor jfd(open(journal.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644));
+		if (jfd.get() < 0) {
+			throw ines_open_failed();
+		}
+
+		uint8_t record[sizeof(JournalMagic) + 8 + MaxPatchSize * 2];
+		uint8_t *p = record;
+		memcpy(p, JournalMagic, sizeof(JournalMagic));
+		p += sizeof(JournalMagic);
+		memcpy(p, &offset, sizeof(offset));
+		p += sizeof(offset);
+		memcpy(p, &size, sizeof(size));
+		p += sizeof(size);
+		memcpy(p, old_bytes, size);
+		p += size;
+		memcpy(p, new_bytes, size);
+		p += size;
+
+		write_at(jfd.get(), record, p - record, 0);
+		sync_fd(jfd.get());
+		sync_directory(filename);
+	}
+
+	write_at(fd, new_bytes, size, offset);
+
+	if (options.sync || options.journal) {
+		sync_fd(fd);
+	}
+
+	if (options.journal) {
+		unlink(journal.c_str());
+	}
+}
+
+/*------------------------------------------------------------------------------
+// Name: copy_file
+// Desc: overwrites the contents of to with those of from
+//----------------------------------------------------------------------------*/
+void copy_file(int from, int to) {
+
+	std::vector<uint8_t> buffer(CopyChunkSize);
+	off_t offset = 0;
+
+	for (;;) {
+		const ssize_t count = pread(from, buffer.data(), buffer.size(), offset);
+		if (count < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (count < 0) {
+			throw ines_read_failed();
+		}
+
+		if (count == 0) {
+			break;
+		}
+
+		write_at(to, buffer.data(), static_cast<size_t>(count), offset);
+		offset += count;
+	}
+
+	if (ftruncate(to, offset) != 0) {
+		throw ines_write_failed();
+	}
+}
+
+/*------------------------------------------------------------------------------
+// Name: copy_back
+// Desc: copies a rewritten file from temp back into the original's inode. if
+//       that fails partway the original is left half written, so temp is kept
+//       and with a journal recover_header can redo the copy
+//----------------------------------------------------------------------------*/
+void copy_back(const std::string &filename, const std::string &temp, int from, int to, const PatchOptions &options) {
+
+	const std::string journal = filename + JournalSuffix;
+
+	if (options.journal) {
+		try {
+			Descriptor jfd(open(journal.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644));
+			if (jfd.get() < 0) {
+				throw ines_open_failed();
+			}
+
+			const auto length = static_cast<uint32_t>(temp.size());
+			std::vector<uint8_t> record(sizeof(CopyJournalMagic) + sizeof(length) + length);
+			memcpy(record.data(), CopyJournalMagic, sizeof(CopyJournalMagic));
+			memcpy(record.data() + sizeof(CopyJournalMagic), &length, sizeof(length));
+			memcpy(record.data() + sizeof(CopyJournalMagic) + sizeof(length), temp.data(), length);
+
+			write_at(jfd.get(), record.data(), record.size(), 0);
+			sync_fd(jfd.get());
+			sync_directory(temp);
+			sync_directory(filename);
+		} catch (const ines_error &) {
+			/* the original hasn't been touched yet */
+			unlink(journal.c_str());
+			unlink(temp.c_str());
+			throw;
+		}
+	}
+
+	copy_file(from, to);
+
+	if (options.sync || options.journal) {
+		sync_fd(to);
+	}
+
+	if (options.journal) {
+		unlink(journal.c_str());
+	}
+
+	unlink(temp.c_str());
+}
+
+#ifndef ZLIB_NOT_FOUND
+/*------------------------------------------------------------------------------
+// Name: stored_member
+//----------------------------------------------------------------------------*/
+void stored_member(uint8_t *member, const Header &header) {
+
+	const uint32_t crc  = ines_crc32(&header, sizeof(Header), 0);
+	const uint32_t size = sizeof(Header);
+
+	memcpy(member, StoredPrefix, sizeof(StoredPrefix));
+	memcpy(member + StoredDataOffset, &header, sizeof(Header));
+
+	uint8_t *trailer = member + StoredDataOffset + sizeof(Header);
+	for (int i = 0; i < 4; ++i) {
+		trailer[i]     = static_cast<uint8_t>(crc >> (i * 8));
+		trailer[i + 4] = static_cast<uint8_t>(size >> (i * 8));
+	}
+}
+
+/*------------------------------------------------------------------------------
+// Name: rewrite_gzip
+// Desc: rewrites a .gz file as a stored member holding the header followed by
+//       a member with the rest of the ROM, through a uniquely named temporary
+//       file which is then renamed over the original. a file with several
+//       hard links, or whose owner can't be kept, is copied back into its own
+//       inode instead. that isn't atomic, so it is only done when
+//       options.in_place is set
+//----------------------------------------------------------------------------*/
+bool rewrite_gzip(const std::string &filename, int fd, const Header &header, const PatchOptions &options) {
+
+	gzFile in = gzdopen(dup(fd), "rb");
+	if (!in) {
+		throw ines_open_failed();
+	}
+
+	Header old_header;
+	if (gzread(in, &old_header, sizeof(Header)) != sizeof(Header)) {
+		gzclose(in);
+		throw ines_read_failed();
+	}
+
+	if (!old_header.isValid()) {
+		gzclose(in);
+		throw ines_bad_header();
+	}
+
+	if (memcmp(&old_header, &header, sizeof(Header)) == 0) {
+		gzclose(in);
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		gzclose(in);
+		throw ines_read_failed();
+	}
+
+	bool in_place = st.st_nlink > 1;
+	if (in_place && !options.in_place) {
+		gzclose(in);
+		throw ines_not_replaceable();
+	}
+
+	/* symlinks are followed, so that the file they point at is the one
+	 * which gets replaced */
+	char *const resolved = realpath(filename.c_str(), nullptr);
+	if (!resolved) {
+		gzclose(in);
+		throw ines_open_failed();
+	}
+
+	const std::string target(resolved);
+	free(resolved);
+
+	std::string temp = target.substr(0, target.find_last_of('/') + 1) + ".ines-patch-XXXXXX";
+	std::vector<char> temp_name(temp.c_str(), temp.c_str() + temp.size() + 1);
+
+	Descriptor out(mkstemp(temp_name.data()));
+	if (out.get() < 0) {
+		gzclose(in);
+		throw ines_open_failed();
+	}
+
+	temp = temp_name.data();
+
+	try {
+		/* a replacement which can't keep the original's owner, such as when
+		 * patching someone else's file, has to be copied back in place too */
+		if (!in_place && fchown(out.get(), st.st_uid, st.st_gid) != 0) {
+			if (!options.in_place) {
+				throw ines_not_replaceable();
+			}
+
+			in_place = true;
+		}
+
+		if (fchmod(out.get(), st.st_mode & 07777) != 0) {
+			throw ines_write_failed();
+		}
+
+		uint8_t member[StoredMemberSize];
+		stored_member(member, header);
+		write_at(out.get(), member, sizeof(member), 0);
+
+		if (lseek(out.get(), sizeof(member), SEEK_SET) < 0) {
+			throw ines_write_failed();
+		}
+
+		gzFile gz = gzdopen(dup(out.get()), "wb");
+		if (!gz) {
+			throw ines_open_failed();
+		}
+
+		std::vector<uint8_t> buffer(CopyChunkSize);
+		int count;
+		while ((count = gzread(in, buffer.data(), static_cast<unsigned>(buffer.size()))) > 0) {
+			if (gzwrite(gz, buffer.data(), static_cast<unsigned>(count)) != count) {
+				gzclose(gz);
+				throw ines_write_failed();
+			}
+		}
+
+		if (gzclose(gz) != Z_OK) {
+			throw ines_write_failed();
+		}
+
+		if (count < 0) {
+			throw ines_read_failed();
+		}
+
+		if (options.sync || options.journal) {
+			sync_fd(out.get());
+		}
+	} catch (const ines_error &) {
+		gzclose(in);
+		unlink(temp.c_str());
+		throw;
+	}
+
+	gzclose(in);
+
+	if (in_place) {
+		copy_back(filename, temp, out.get(), fd, options);
+		return true;
+	}
+
+	if (rename(temp.c_str(), target.c_str()) != 0) {
+		unlink(temp.c_str());
+		throw ines_write_failed();
+	}
+
+	if (options.sync || options.journal) {
+		sync_directory(target);
+	}
+
+	return true;
+}
+#endif
+
+}
+
+/*-----------------------------------------------------------------------------
+// Name: read_header
+//---------------------------------------------------------------------------*/
+Header read_header(const char *filename) {
+
+	assert(filename != nullptr);
+
+	Header header;
+
+#ifndef ZLIB_NOT_FOUND
+	gzFile file = gzopen(filename, "rb");
+	if (!file) {
+		throw ines_open_failed();
+	}
+
+	const bool ok = gzread(file, &header, sizeof(Header)) == sizeof(Header);
+	gzclose(file);
+#else
+	FILE *file = fopen(filename, "rb");
+	if (!file) {
+		throw ines_open_failed();
+	}
+
+	const bool ok = fread(&header, 1, sizeof(Header), file) == sizeof(Header);
+	fclose(file);
+#endif
+
+	if (!ok) {
+		throw ines_read_failed();
+	}
+
+	if (!header.isValid()) {
+		throw ines_bad_header();
+	}
+
+	return header;
+}
+
+/*-----------------------------------------------------------------------------
+// Name: patch_header
+//---------------------------------------------------------------------------*/
+bool patch_header(const char *filename, const Header &header, const PatchOptions &options) {
+
+	assert(filename != nullptr);
+
+	if (!header.isValid()) {
+		throw ines_bad_header();
+	}
+
+	Descriptor fd(open(filename, O_RDWR));
+	if (fd.get() < 0) {
+		throw ines_open_failed();
+	}
+
+	uint8_t magic[2];
+	if (!read_at(fd.get(), magic, sizeof(magic), 0)) {
+		throw ines_read_failed();
+	}
+
+	if (magic[0] != 0x1f || magic[1] != 0x8b) {
+		Header old_header;
+		if (!read_at(fd.get(), &old_header, sizeof(Header), 0)) {
+			throw ines_read_failed();
+		}
+
+		if (!old_header.isValid()) {
+			throw ines_bad_header();
+		}
+
+		if (memcmp(&old_header, &header, sizeof(Header)) == 0) {
+			return false;
+		}
+
+		patch_bytes(filename, fd.get(), 0, reinterpret_cast<const uint8_t *>(&old_header), reinterpret_cast<const uint8_t *>(&header), sizeof(Header), options);
+		return true;
+	}
+
+#ifndef ZLIB_NOT_FOUND
+	uint8_t old_member[StoredMemberSize];
+	const bool stored = read_at(fd.get(), old_member, sizeof(old_member), 0) && memcmp(old_member, StoredPrefix, sizeof(StoredPrefix)) == 0;
+
+	if (!stored) {
+		return rewrite_gzip(filename, fd.get(), header, options);
+	}
+
+	Header old_header;
+	memcpy(&old_header, old_member + StoredDataOffset, sizeof(Header));
+	if (!old_header.isValid()) {
+		throw ines_bad_header();
+	}
+
+	uint8_t new_member[StoredMemberSize];
+	stored_member(new_member, header);
+
+	/* the header and the CRC following it are the only bytes which change */
+	const uint32_t size = sizeof(Header) + 4;
+	if (memcmp(old_member + StoredDataOffset, new_member + StoredDataOffset, size) == 0) {
+		return false;
+	}
+
+	patch_bytes(filename, fd.get(), StoredDataOffset, old_member + StoredDataOffset, new_member + StoredDataOffset, size, options);
+	return true;
+#else
+	throw ines_unsupported_file_type();
+#endif
+}
+
+/*-----------------------------------------------------------------------------
+// Name: recover_header
+// Desc: a journal which was only partially written means the file itself was
+//       never touched, so it is simply discarded. a journal may also name the
+//       rewritten copy of a .gz file which was being copied back in place
+//---------------------------------------------------------------------------*/
+bool recover_header(const char *filename) {
+
+	assert(filename != nullptr);
+
+	const std::string journal = std::string(filename) + JournalSuffix;
+
+	uint8_t record[sizeof(CopyJournalMagic) + 4 + PATH_MAX];
+	ssize_t length;
+	{
+		Descriptor jfd(open(journal.c_str(), O_RDONLY));
+		if (jfd.get() < 0) {
+			return false;
+		}
+
+		length = pread(jfd.get(), record, sizeof(record), 0);
+	}
+
+	if (length >= static_cast<ssize_t>(sizeof(CopyJournalMagic) + 4) && memcmp(record, CopyJournalMagic, sizeof(CopyJournalMagic)) == 0) {
+		uint32_t size;
+		memcpy(&size, record + sizeof(CopyJournalMagic), sizeof(size));
+
+		if (length == static_cast<ssize_t>(sizeof(CopyJournalMagic) + 4 + size)) {
+			const std::string temp(reinterpret_cast<const char *>(record) + sizeof(CopyJournalMagic) + 4, size);
+
+			Descriptor from(open(temp.c_str(), O_RDONLY));
+			if (from.get() < 0) {
+				throw ines_open_failed();
+			}
+
+			Descriptor fd(open(filename, O_RDWR));
+			if (fd.get() < 0) {
+				throw ines_open_failed();
+			}
+
+			copy_file(from.get(), fd.get());
+			sync_fd(fd.get());
+			unlink(journal.c_str());
+			unlink(temp.c_str());
+			return true;
+		}
+
+		unlink(journal.c_str());
+		return true;
+	}
+
+	uint32_t offset = 0;
+	uint32_t size   = 0;
+	bool complete   = length >= static_cast<ssize_t>(sizeof(JournalMagic) + 8) && memcmp(record, JournalMagic, sizeof(JournalMagic)) == 0;
+
+	if (complete) {
+		memcpy(&offset, record + sizeof(JournalMagic), sizeof(offset));
+		memcpy(&size, record + sizeof(JournalMagic) + 4, sizeof(size));
+		complete = size <= MaxPatchSize && length == static_cast<ssize_t>(sizeof(JournalMagic) + 8 + size * 2);
+	}
+
+	if (complete) {
+		Descriptor fd(open(filename, O_RDWR));
+		if (fd.get() < 0) {
+			throw ines_open_failed();
+		}
+
+		write_at(fd.get(), record + sizeof(JournalMagic) + 8 + size, size, offset);
+		sync_fd(fd.get());
+	}
+
+	unlink(journal.c_str());
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+// Name: patch_headers
+//---------------------------------------------------------------------------*/
+PatchResult patch_headers(const std::vector<std::string> &filenames, const HeaderFixer &fix, const PatchOptions &options) {
+
+	PatchResult result;
+
+	for (const std::string &filename : filenames) {
+		try {
+			Header header = read_header(filename.c_str());
+
+			if (fix(header) && patch_header(filename.c_str(), header, options)) {
+				++result.patched;
+			} else {
+				++result.unchanged;
+			}
+		} catch (const ines_error &e) {
+			result.failed.emplace_back(filename, e.what());
+		}
+	}
+
+	return result;
+}
+
+}
@@ -0,0 +1,195 @@
+/*
+Copyright (C) 2000 - 2016 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "iNES/SaveRam.h"
+#include "iNES/Error.h"
+#include "iNES/Header.h"
+
+#include <algorithm>
+#include <cassert>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace iNES {
+
+/*-----------------------------------------------------------------------------
+// Name: SaveRam
+//---------------------------------------------------------------------------*/
+SaveRam::SaveRam(const char *filename, size_t size)
+	: size_(size), page_size_(static_cast<size_t>(sysconf(_SC_PAGESIZE))) {
+
+	assert(filename != nullptr);
+
+	if (size_ == 0) {
+		return;
+	}
+
+	fd_ = open(filename, O_RDWR | O_CREAT, 0644);
+	if (fd_ < 0) {
+		throw ines_open_failed();
+	}
+
+	try {
+		struct stat st;
+		if (fstat(fd_, &st) != 0) {
+			throw ines_read_failed();
+		}
+
+		if (static_cast<size_t>(st.st_size) < size_ && ftruncate(fd_, static_cast<off_t>(size_)) != 0) {
+			throw ines_write_failed();
+		}
+
+		void *const p = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+		if (p == MAP_FAILED) {
+			throw ines_open_failed();
+		}
+
+		data_ = static_cast<uint8_t *>(p);
+	} catch (const ines_error &) {
+		close(fd_);
+		throw;
+	}
+
+	dirty_pages_.resize((size_ + page_size_ - 1) / page_size_);
+}
+
+/*-----------------------------------------------------------------------------
+// Name: SaveRam
+//---------------------------------------------------------------------------*/
+SaveRam::SaveRam(const char *filename, const Header &header)
+	: SaveRam(filename, header.prg_nvram_size() + header.chr_nvram_size()) {
+}
+
+/*-----------------------------------------------------------------------------
+// Name: ~SaveRam
+//---------------------------------------------------------------------------*/
+SaveRam::~SaveRam() {
+
+	if (data_) {
+		try {
+			sync();
+		} catch (const ines_error &) {
+		}
+		munmap(data_, size_);
+	}
+
+	if (fd_ >= 0) {
+		close(fd_);
+	}
+}
+
+/*-----------------------------------------------------------------------------
+// Name: read
+//---------------------------------------------------------------------------*/
+uint8_t SaveRam::read(size_t offset) const {
+	assert(offset < size_);
+	return data_[offset];
+}
+
+/*-----------------------------------------------------------------------------
+// Name: write
+//---------------------------------------------------------------------------*/
+void SaveRam::write(size_t offset, uint8_t value) {
+	assert(offset < size_);
+	data_[offset]                     = value;
+	dirty_pages_[offset / page_size_] = true;
+	dirty_                            = true;
+}
+
+/*-----------------------------------------------------------------------------
+// Name: mark_dirty
+//---------------------------------------------------------------------------*/
+void SaveRam::mark_dirty(size_t offset, size_t length) {
+
+	assert(offset + length <= size_);
+
+	if (length == 0) {
+		return;
+	}
+
+	for (size_t page = offset / page_size_; page <= (offset + length - 1) / page_size_; ++page) {
+		dirty_pages_[page] = true;
+	}
+
+	dirty_ = true;
+}
+
+/*-----------------------------------------------------------------------------
+// Name: dirty
+//---------------------------------------------------------------------------*/
+bool SaveRam::dirty() const {
+	return dirty_;
+}
+
+/*-----------------------------------------------------------------------------
+// Name: sync
+// Desc: flushes each run of consecutive dirty pages with one msync, on
+//       failure the runs not yet flushed are still marked dirty
+//---------------------------------------------------------------------------*/
+void SaveRam::sync(bool wait) {
+
+	if (!dirty_) {
+		return;
+	}
+
+	const size_t pages = dirty_pages_.size();
+
+	size_t page = 0;
+	while (page < pages) {
+		if (!dirty_pages_[page]) {
+			++page;
+			continue;
+		}
+
+		const size_t first = page;
+		while (page < pages && dirty_pages_[page]) {
+			++page;
+		}
+
+		const size_t offset = first * page_size_;
+		const size_t length = std::min(page * page_size_, size_) - offset;
+
+		/* a run stays marked until it has actually been flushed, so a
+		 * failed sync can simply be retried */
+		if (msync(data_ + offset, length, wait ? MS_SYNC : MS_ASYNC) != 0) {
+			throw ines_write_failed();
+		}
+
+		std::fill(dirty_pages_.begin() + first, dirty_pages_.begin() + page, false);
+	}
+
+	dirty_ = false;
+}
+
+/*-----------------------------------------------------------------------------
+// Name: data
+//---------------------------------------------------------------------------*/
+uint8_t *SaveRam::data() const {
+	return data_;
+}
+
+/*-----------------------------------------------------------------------------
+// Name: size
+//---------------------------------------------------------------------------*/
+size_t SaveRam::size() const {
+	return size_;
+}
+
+}
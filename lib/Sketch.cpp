@@ -0,0 +1,218 @@
+/*
+Copyright (C) 2000 - 2016 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "iNES/Sketch.h"
+#include "iNES/Rom.h"
+#include "Crc32.h"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+namespace iNES {
+namespace {
+
+/*------------------------------------------------------------------------------
+// Name: mix64
+// Desc: splitmix64 finalizer, used as the family of min-hash functions
+//----------------------------------------------------------------------------*/
+uint64_t mix64(uint64_t x) {
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return x;
+}
+
+/*------------------------------------------------------------------------------
+// Name: bank_hashes
+// Desc: appends the hash of every bank in a section, tagged with the section
+//       so that identical PRG and CHR banks are not considered the same
+//----------------------------------------------------------------------------*/
+void bank_hashes(std::vector<uint64_t> &hashes, const uint8_t *data, uint32_t size, uint64_t tag) {
+
+	if (data == nullptr) {
+		return;
+	}
+
+	for (uint32_t offset = 0; offset < size; offset += Sketch::BankSize) {
+		const uint32_t length = std::min<uint32_t>(Sketch::BankSize, size - offset);
+		hashes.push_back((tag << 32) | ines_crc32(data + offset, length, 0));
+	}
+}
+
+/*------------------------------------------------------------------------------
+// Name: band_key
+//----------------------------------------------------------------------------*/
+uint64_t band_key(const Sketch &sketch, int band) {
+
+	uint64_t key = static_cast<uint64_t>(band);
+	for (int i = 0; i < SketchIndex::Rows; ++i) {
+		key = mix64(key ^ sketch.values()[band * SketchIndex::Rows + i]);
+	}
+
+	return key;
+}
+
+}
+
+/*-----------------------------------------------------------------------------
+// Name: Sketch
+//---------------------------------------------------------------------------*/
+Sketch::Sketch(const Rom &rom) {
+
+	std::vector<uint64_t> hashes;
+	bank_hashes(hashes, rom.prg_rom(), rom.prg_size(), 1);
+	bank_hashes(hashes, rom.chr_rom(), rom.chr_size(), 2);
+
+	/* the sketch is over the set of banks, so repeated banks (overdumps,
+	 * mirrored data, padding) only count once */
+	std::sort(hashes.begin(), hashes.end());
+	hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+
+	values_.fill(std::numeric_limits<uint32_t>::max());
+
+	for (uint64_t hash : hashes) {
+		for (int i = 0; i < Size; ++i) {
+			const auto value = static_cast<uint32_t>(mix64(hash ^ mix64(i + 1)));
+			values_[i]       = std::min(values_[i], value);
+		}
+	}
+}
+
+/*-----------------------------------------------------------------------------
+// Name: similarity
+// Desc: estimated Jaccard similarity of the two ROMs' sets of banks
+//---------------------------------------------------------------------------*/
+double Sketch::similarity(const Sketch &other) const {
+
+	int matches = 0;
+	for (int i = 0; i < Size; ++i) {
+		if (values_[i] == other.values_[i]) {
+			++matches;
+		}
+	}
+
+	return static_cast<double>(matches) / Size;
+}
+
+/*-----------------------------------------------------------------------------
+// Name: values
+//---------------------------------------------------------------------------*/
+const std::array<uint32_t, Sketch::Size> &Sketch::values() const {
+	return values_;
+}
+
+/*-----------------------------------------------------------------------------
+// Name: insert
+//---------------------------------------------------------------------------*/
+size_t SketchIndex::insert(const Sketch &sketch) {
+
+	const size_t id = sketches_.size();
+	sketches_.push_back(sketch);
+
+	for (int band = 0; band < Bands; ++band) {
+		buckets_[band][band_key(sketch, band)].push_back(id);
+	}
+
+	return id;
+}
+
+/*-----------------------------------------------------------------------------
+// Name: query
+// Desc: returns the indexed sketches sharing at least one band with the given
+//       one whose estimated similarity is at least threshold, best first
+//---------------------------------------------------------------------------*/
+std::vector<SketchIndex::Match> SketchIndex::query(const Sketch &sketch, double threshold) const {
+
+	std::vector<size_t> candidates;
+	for (int band = 0; band < Bands; ++band) {
+		auto it = buckets_[band].find(band_key(sketch, band));
+		if (it != buckets_[band].end()) {
+			candidates.insert(candidates.end(), it->second.begin(), it->second.end());
+		}
+	}
+
+	std::sort(candidates.begin(), candidates.end());
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+	std::vector<Match> matches;
+	for (size_t id : candidates) {
+		const double similarity = sketch.similarity(sketches_[id]);
+		if (similarity >= threshold) {
+			matches.push_back(Match{id, similarity});
+		}
+	}
+
+	std::sort(matches.begin(), matches.end(), [](const Match &lhs, const Match &rhs) {
+		return lhs.similarity > rhs.similarity;
+	});
+
+	return matches;
+}
+
+/*-----------------------------------------------------------------------------
+// Name: pairs
+// Desc: returns every pair of indexed sketches sharing a bucket whose
+//       estimated similarity is at least threshold, ordered by id
+//---------------------------------------------------------------------------*/
+std::vector<SketchIndex::Pair> SketchIndex::pairs(double threshold) const {
+
+	std::vector<std::pair<size_t, size_t>> candidates;
+	for (const auto &band : buckets_) {
+		for (const auto &bucket : band) {
+			const std::vector<size_t> &ids = bucket.second;
+			for (size_t i = 0; i < ids.size(); ++i) {
+				for (size_t j = i + 1; j < ids.size(); ++j) {
+					candidates.emplace_back(ids[i], ids[j]);
+				}
+			}
+		}
+	}
+
+	std::sort(candidates.begin(), candidates.end());
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+	std::vector<Pair> result;
+	for (const auto &candidate : candidates) {
+		const double similarity = sketches_[candidate.first].similarity(sketches_[candidate.second]);
+		if (similarity >= threshold) {
+			result.push_back(Pair{candidate.first, candidate.second, similarity});
+		}
+	}
+
+	return result;
+}
+
+/*-----------------------------------------------------------------------------
+// Name: sketch
+//---------------------------------------------------------------------------*/
+const Sketch &SketchIndex::sketch(size_t id) const {
+	assert(id < sketches_.size());
+	return sketches_[id];
+}
+
+/*-----------------------------------------------------------------------------
+// Name: size
+//---------------------------------------------------------------------------*/
+size_t SketchIndex::size() const {
+	return sketches_.size();
+}
+
+}
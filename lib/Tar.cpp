@@ -0,0 +1,253 @@
+/*
+Copyright (C) 2000 - 2016 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Tar.h"
+#include "iNES/Error.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+namespace iNES {
+namespace {
+
+constexpr size_t BlockSize          = 512;
+constexpr uint64_t MaxExtensionSize = 0x100000;
+
+/*------------------------------------------------------------------------------
+// Name: parse_number
+// Desc: numeric header fields are octal text, or big endian base-256 when
+//       the high bit of the first byte is set (GNU extension)
+//----------------------------------------------------------------------------*/
+uint64_t parse_number(const uint8_t *field, size_t size) {
+
+	uint64_t value = 0;
+
+	if (field[0] & 0x80) {
+		value = field[0] & 0x7f;
+		for (size_t i = 1; i < size; ++i) {
+			value = (value << 8) | field[i];
+		}
+		return value;
+	}
+
+	size_t i = 0;
+	while (i < size && (field[i] == ' ' || field[i] == '\0')) {
+		++i;
+	}
+
+	while (i < size && field[i] >= '0' && field[i] <= '7') {
+		value = (value << 3) | (field[i] - '0');
+		++i;
+	}
+
+	return value;
+}
+
+/*------------------------------------------------------------------------------
+// Name: parse_string
+//----------------------------------------------------------------------------*/
+std::string parse_string(const uint8_t *field, size_t size) {
+	const auto *end = static_cast<const uint8_t *>(memchr(field, 0, size));
+	return std::string(reinterpret_cast<const char *>(field), end ? end - field : size);
+}
+
+}
+
+/*-----------------------------------------------------------------------------
+// Name: TarParser
+//---------------------------------------------------------------------------*/
+TarParser::TarParser(MemberHandler on_member, DataHandler on_data)
+	: on_member_(std::move(on_member)), on_data_(std::move(on_data)) {
+}
+
+/*-----------------------------------------------------------------------------
+// Name: feed
+//---------------------------------------------------------------------------*/
+void TarParser::feed(const uint8_t *data, size_t size) {
+
+	while (size != 0 && state_ != State::END) {
+		size_t count = 0;
+
+		switch (state_) {
+		case State::HEADER:
+			count = std::min(BlockSize - block_fill_, size);
+			memcpy(block_ + block_fill_, data, count);
+			block_fill_ += count;
+			position_ += count;
+			if (block_fill_ == BlockSize) {
+				block_fill_ = 0;
+				process_header();
+			}
+			break;
+
+		case State::DATA:
+			count = static_cast<size_t>(std::min<uint64_t>(remaining_, size));
+			if (extension_ != Extension::NONE) {
+				extension_data_.append(reinterpret_cast<const char *>(data), count);
+			} else if (regular_ && on_data_) {
+				on_data_(data, count);
+			}
+			remaining_ -= count;
+			position_ += count;
+			if (remaining_ == 0) {
+				process_extension();
+				remaining_ = padding_;
+				state_     = (padding_ != 0) ? State::PADDING : State::HEADER;
+			}
+			break;
+
+		case State::PADDING:
+			count = static_cast<size_t>(std::min<uint64_t>(remaining_, size));
+			remaining_ -= count;
+			position_ += count;
+			if (remaining_ == 0) {
+				state_ = State::HEADER;
+			}
+			break;
+
+		case State::END:
+			break;
+		}
+
+		data += count;
+		size -= count;
+	}
+}
+
+/*-----------------------------------------------------------------------------
+// Name: process_header
+//---------------------------------------------------------------------------*/
+void TarParser::process_header() {
+
+	if (std::all_of(block_, block_ + BlockSize, [](uint8_t ch) { return ch == 0; })) {
+		state_ = State::END;
+		return;
+	}
+
+	/* the checksum is computed with the checksum field itself as spaces */
+	uint64_t checksum = 0;
+	for (size_t i = 0; i < BlockSize; ++i) {
+		checksum += (i >= 148 && i < 156) ? ' ' : block_[i];
+	}
+
+	if (checksum != parse_number(block_ + 148, 8)) {
+		throw ines_bad_archive();
+	}
+
+	const uint64_t size = parse_number(block_ + 124, 12);
+	const uint8_t type  = block_[156];
+
+	regular_   = false;
+	extension_ = Extension::NONE;
+
+	switch (type) {
+	case 'L':
+		extension_ = Extension::GNU_LONGNAME;
+		break;
+	case 'x':
+		extension_ = Extension::PAX;
+		break;
+	case '0':
+	case '7':
+	case '\0': {
+		std::string name = std::move(next_name_);
+		if (name.empty()) {
+			name = parse_string(block_, 100);
+			if (memcmp(block_ + 257, "ustar", 5) == 0 && block_[345] != '\0') {
+				name = parse_string(block_ + 345, 155) + '/' + name;
+			}
+		}
+
+		regular_ = true;
+		on_member_(name, position_, size);
+		break;
+	}
+	default:
+		break;
+	}
+
+	if (extension_ != Extension::NONE) {
+		if (size > MaxExtensionSize) {
+			throw ines_bad_archive();
+		}
+		extension_data_.clear();
+	} else {
+		next_name_.clear();
+	}
+
+	remaining_ = size;
+	padding_   = (BlockSize - size % BlockSize) % BlockSize;
+
+	if (remaining_ != 0) {
+		state_ = State::DATA;
+	} else {
+		process_extension();
+		remaining_ = padding_;
+		state_     = State::HEADER;
+	}
+}
+
+/*-----------------------------------------------------------------------------
+// Name: process_extension
+// Desc: picks the name of the next member out of a GNU long name or pax
+//       extended header, once its data has been collected
+//---------------------------------------------------------------------------*/
+void TarParser::process_extension() {
+
+	switch (extension_) {
+	case Extension::GNU_LONGNAME:
+		next_name_ = extension_data_.substr(0, extension_data_.find('\0'));
+		break;
+	case Extension::PAX: {
+		/* records are of the form "<length> <key>=<value>\n" */
+		size_t pos = 0;
+		while (pos < extension_data_.size()) {
+			const size_t length = strtoull(extension_data_.c_str() + pos, nullptr, 10);
+			if (length == 0 || pos + length > extension_data_.size()) {
+				throw ines_bad_archive();
+			}
+
+			const std::string record = extension_data_.substr(pos, length);
+			const size_t key         = record.find(' ');
+			const size_t equals      = record.find('=');
+			if (key != std::string::npos && equals != std::string::npos && record.compare(key + 1, equals - key - 1, "path") == 0) {
+				next_name_ = record.substr(equals + 1, record.size() - equals - 2);
+			}
+
+			pos += length;
+		}
+		break;
+	}
+	case Extension::NONE:
+		break;
+	}
+
+	extension_ = Extension::NONE;
+}
+
+/*-----------------------------------------------------------------------------
+// Name: finished
+// Desc: true once the end of archive marker has been seen
+//---------------------------------------------------------------------------*/
+bool TarParser::finished() const {
+	return state_ == State::END;
+}
+
+}
@@ -0,0 +1,79 @@
+/*
+Copyright (C) 2000 - 2016 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INES_TAR_20261019_H_
+#define INES_TAR_20261019_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace iNES {
+
+/* incremental parser for ustar/GNU/pax tar streams, the stream can be fed in
+ * pieces of any size. only regular files are reported, the data of each one
+ * is passed on as it goes by */
+class TarParser {
+public:
+	using MemberHandler = std::function<void(const std::string &name, uint64_t offset, uint64_t size)>;
+	using DataHandler   = std::function<void(const uint8_t *data, size_t size)>;
+
+public:
+	TarParser(MemberHandler on_member, DataHandler on_data);
+
+public:
+	void feed(const uint8_t *data, size_t size);
+	bool finished() const;
+
+private:
+	void process_header();
+	void process_extension();
+
+private:
+	enum class State {
+		HEADER,
+		DATA,
+		PADDING,
+		END
+	};
+
+	enum class Extension {
+		NONE,
+		GNU_LONGNAME,
+		PAX
+	};
+
+private:
+	MemberHandler on_member_;
+	DataHandler on_data_;
+	State state_         = State::HEADER;
+	Extension extension_ = Extension::NONE;
+	uint8_t block_[512];
+	size_t block_fill_  = 0;
+	uint64_t position_  = 0; /* offset into the tar stream */
+	uint64_t remaining_ = 0; /* bytes left in the current data or padding */
+	uint64_t padding_   = 0; /* padding which follows the current data */
+	bool regular_       = false;
+	std::string extension_data_;
+	std::string next_name_; /* name given by a preceding GNU/pax header */
+};
+
+}
+
+#endif
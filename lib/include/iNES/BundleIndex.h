@@ -0,0 +1,88 @@
+/*
+Copyright (C) 2000 - 2016 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INES_BUNDLE_INDEX_20261019_H_
+#define INES_BUNDLE_INDEX_20261019_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace iNES {
+
+class Rom;
+
+/* random access into a .tar.gz bundle (single or multi-member gzip), using
+ * access points at deflate block boundaries every span bytes of output, each
+ * with the 32K window needed to resume inflating from there. the index is
+ * saved next to the bundle as <bundle>.idx and reused while the bundle's size,
+ * modification time and the CRCs of its first and last 64K are unchanged */
+class BundleIndex {
+public:
+	static constexpr uint64_t DefaultSpan = 0x100000;
+
+	struct Member {
+		std::string name;
+		uint64_t offset; /* offset of the data in the uncompressed tar */
+		uint64_t size;
+	};
+
+public:
+	explicit BundleIndex(const char *filename, uint64_t span = DefaultSpan);
+
+public:
+	void write(const char *filename) const;
+
+public:
+	const std::vector<Member> &members() const;
+	const Member *find(const std::string &name) const;
+	std::vector<uint8_t> read(const Member &member) const;
+	Rom load(const std::string &name) const;
+
+private:
+	struct AccessPoint {
+		uint64_t out;                /* offset in the uncompressed data */
+		uint64_t in;                 /* offset in the compressed data of the first full byte */
+		uint8_t bits;                /* bits of the preceding byte which are still to be used */
+		uint32_t window_size;        /* uncompressed size of the window */
+		std::vector<uint8_t> window; /* compressed copy of the window */
+	};
+
+	/* identifies the bundle an index was built from */
+	struct Fingerprint {
+		uint64_t size;
+		int64_t mtime_sec;
+		int64_t mtime_nsec;
+		uint32_t head_crc; /* CRC32 of the first 64K */
+		uint32_t tail_crc; /* CRC32 of the last 64K */
+	};
+
+private:
+	void build(uint64_t span);
+	bool read_index(const std::string &filename);
+
+private:
+	std::string filename_;
+	Fingerprint fingerprint_ = {};
+	std::vector<AccessPoint> points_;
+	std::vector<Member> members_; /* sorted by name */
+};
+
+}
+
+#endif
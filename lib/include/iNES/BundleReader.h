@@ -0,0 +1,43 @@
+/*
+Copyright (C) 2000 - 2016 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INES_BUNDLE_READER_20261019_H_
+#define INES_BUNDLE_READER_20261019_H_
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+namespace iNES {
+
+class Rom;
+class ines_error;
+
+using RomConsumer  = std::function<void(const std::string &name, Rom &rom)>;
+using ErrorHandler = std::function<void(const std::string &name, const ines_error &error)>;
+
+/* reads every member of a .tar or .tar.gz bundle in one pass, handing each
+ * one to consumer as a Rom in archive order. decompression and tar parsing
+ * run on a thread of their own, while loading the Rom and the consumer run on
+ * the calling thread, with at most queue_depth members buffered in between.
+ * members which are not valid ROMs go to on_error, or are skipped without one */
+void read_bundle(const char *filename, const RomConsumer &consumer, const ErrorHandler &on_error = nullptr, size_t queue_depth = 16);
+
+}
+
+#endif
@@ -0,0 +1,94 @@
+/*
+Copyright (C) 2000 - 2016 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INES_COMPRESSED_ROM_20261019_H_
+#define INES_COMPRESSED_ROM_20261019_H_
+
+#include "iNES/Header.h"
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace iNES {
+
+class Rom;
+
+/* a ROM whose PRG and CHR banks are held compressed, banks are decompressed
+ * on first access into a bounded set of the most recently used ones */
+class CompressedRom {
+public:
+	using Bank = std::shared_ptr<const std::vector<uint8_t>>;
+
+public:
+	CompressedRom(const Rom &rom, size_t hot_banks);
+	CompressedRom(const CompressedRom &) = delete;
+	CompressedRom &operator=(const CompressedRom &) = delete;
+	~CompressedRom()                                = default;
+
+public:
+	uint32_t prg_size() const;
+	uint32_t chr_size() const;
+	uint32_t prg_banks() const;  /* in PrgBlockSize banks */
+	uint32_t chr_banks() const;  /* in ChrBlockSize banks */
+	const Header *header() const;
+	const uint8_t *trainer() const;
+	size_t compressed_size() const;
+
+public:
+	/* the returned bank stays valid for as long as the caller holds it,
+	 * even if it is evicted from the hot set meanwhile. an index past the
+	 * last bank throws ines_bad_bank, mappers wrap it themselves */
+	Bank prg_bank(uint32_t index);
+	Bank chr_bank(uint32_t index);
+
+public:
+	uint64_t hits() const;
+	uint64_t misses() const;
+
+private:
+	Bank bank(uint32_t section, uint32_t index);
+
+private:
+	struct Entry {
+		Bank bank;
+		std::list<uint64_t>::iterator lru;
+	};
+
+private:
+	Header header_;
+	std::unique_ptr<uint8_t[]> trainer_;
+	std::vector<std::vector<uint8_t>> prg_banks_; /* compressed PRG banks */
+	std::vector<std::vector<uint8_t>> chr_banks_; /* compressed CHR banks */
+	uint32_t prg_size_ = 0;
+	uint32_t chr_size_ = 0;
+
+	mutable std::mutex mutex_;
+	size_t hot_banks_;
+	std::list<uint64_t> lru_; /* most recently used first */
+	std::unordered_map<uint64_t, Entry> hot_;
+	uint64_t hits_   = 0;
+	uint64_t misses_ = 0;
+};
+
+}
+
+#endif
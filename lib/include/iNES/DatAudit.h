@@ -0,0 +1,70 @@
+/*
+Copyright (C) 2000 - 2016 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INES_DAT_AUDIT_20261019_H_
+#define INES_DAT_AUDIT_20261019_H_
+
+#include "iNES/DatIndex.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace iNES {
+
+class Header;
+class Rom;
+
+enum class DatStatus {
+	MATCHED,    /* data and header are good */
+	BAD_HEADER, /* data matches a DAT entry, but the header is dirty */
+	UNKNOWN     /* data matches no DAT entry */
+};
+
+/* verifies a batch of ROMs against a DatIndex, ROMs are fed in one at a time
+ * so the batch never needs to be held in memory */
+class DatAudit {
+public:
+	struct Result {
+		std::string filename;
+		DatStatus status;
+		const DatIndex::Entry *entry; /* nullptr for UNKNOWN */
+	};
+
+public:
+	explicit DatAudit(const DatIndex &index);
+
+public:
+	DatStatus add(const std::string &filename, const Rom &rom);
+
+	/* md5 (16 bytes) and sha1 (20 bytes) are optional, each is compared only
+	 * when the DAT entry has that digest too */
+	DatStatus add(const std::string &filename, const Header &header, uint32_t crc, uint32_t size, const uint8_t *md5 = nullptr, const uint8_t *sha1 = nullptr);
+
+public:
+	const std::vector<Result> &results() const;
+	std::vector<const DatIndex::Entry *> missing() const;
+
+private:
+	const DatIndex &index_;
+	std::vector<bool> seen_;
+	std::vector<Result> results_;
+};
+
+}
+
+#endif
@@ -0,0 +1,68 @@
+/*
+Copyright (C) 2000 - 2016 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INES_DAT_INDEX_20261019_H_
+#define INES_DAT_INDEX_20261019_H_
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace iNES {
+
+/* compiled form of a logiqx XML (No-Intro/TOSEC) DAT file, the ROM entries
+ * are kept sorted by CRC32 and size with their names in one string table */
+class DatIndex {
+public:
+	struct Entry {
+		uint32_t crc;      /* CRC32 of the header-less ROM */
+		uint32_t size;     /* size of the header-less ROM */
+		uint32_t game;     /* offset of the game name in the string table */
+		uint32_t rom;      /* offset of the ROM name in the string table */
+		uint8_t md5[16];   /* all zero if the DAT has no MD5 */
+		uint8_t sha1[20];  /* all zero if the DAT has no SHA-1 */
+	};
+
+	using const_iterator = std::vector<Entry>::const_iterator;
+
+public:
+	/* accepts either a DAT file or an index previously written by write() */
+	explicit DatIndex(const char *filename);
+
+public:
+	void write(const char *filename) const;
+
+public:
+	std::pair<const_iterator, const_iterator> find(uint32_t crc, uint32_t size) const;
+	const std::vector<Entry> &entries() const;
+	const char *game_name(const Entry &entry) const;
+	const char *rom_name(const Entry &entry) const;
+
+private:
+	void parse(const std::string &xml);
+	uint32_t intern(const std::string &s);
+
+private:
+	std::vector<Entry> entries_;
+	std::string strings_;
+};
+
+}
+
+#endif
@@ -63,6 +63,41 @@ public:
 	}
 };
 
+class ines_corrupt_data : public ines_error {
+public:
+	virtual const char *what() const noexcept {
+		return "Corrupt Compressed Data";
+	}
+};
+
+class ines_bad_bank : public ines_error {
+public:
+	virtual const char *what() const noexcept {
+		return "Bank Index Out of Range";
+	}
+};
+
+class ines_bad_dat : public ines_error {
+public:
+	virtual const char *what() const noexcept {
+		return "Bad DAT File";
+	}
+};
+
+class ines_bad_archive : public ines_error {
+public:
+	virtual const char *what() const noexcept {
+		return "Bad Archive";
+	}
+};
+
+class ines_not_replaceable : public ines_error {
+public:
+	virtual const char *what() const noexcept {
+		return "File Can't Be Replaced Atomically";
+	}
+};
+
 }
 
 #endif
@@ -61,6 +61,11 @@ enum class Ppu {
 	RESERVED_3
 };
 
+/* units used by the size fields of the header */
+constexpr int PrgBlockSize = 0x4000;
+constexpr int ChrBlockSize = 0x2000;
+constexpr int TrainerSize  = 512;
+
 /* layout of first sixteen bytes of nes cartridge in ines format */
 class Header {
 public:
@@ -76,8 +81,13 @@ public:
 	System system() const;
 	Mirroring mirroring() const;
 	bool trainer_present() const;
+	bool battery_present() const;
 	uint32_t prg_size() const;
 	uint32_t chr_size() const;
+	uint32_t prg_ram_size() const;   /* in bytes */
+	uint32_t prg_nvram_size() const; /* in bytes */
+	uint32_t chr_ram_size() const;   /* in bytes */
+	uint32_t chr_nvram_size() const; /* in bytes */
 
 public:
 	char ines_signature_[4]; /* 0x1A53454E (NES file signature) */
@@ -0,0 +1,67 @@
+/*
+Copyright (C) 2000 - 2016 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INES_HEADER_PATCH_20261019_H_
+#define INES_HEADER_PATCH_20261019_H_
+
+#include "iNES/Header.h"
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace iNES {
+
+struct PatchOptions {
+	bool sync     = false; /* fsync the file before returning */
+	bool journal  = false; /* journal the write next to the file first, implies sync */
+	bool in_place = false; /* allow a .gz file which can't be renamed over, such as one
+	                        * with several hard links or another owner, to be copied back in place */
+};
+
+struct PatchResult {
+	size_t patched   = 0;
+	size_t unchanged = 0;
+	std::vector<std::pair<std::string, std::string>> failed; /* filename and error */
+};
+
+/* returns true when header has been modified and should be written back */
+using HeaderFixer = std::function<bool(Header &header)>;
+
+Header read_header(const char *filename);
+
+/* replaces the header of an iNES file without rewriting the rest of it, for
+ * plain files this is a single 16 byte write. a .gz file is rewritten once
+ * so its header lives in a small gzip member of its own, patches after that
+ * only rewrite that member in place. that first rewrite replaces the file
+ * with a rename, a file with several hard links or whose owner can't be kept
+ * throws ines_not_replaceable unless options.in_place is set. returns false if the header was already
+ * the same */
+bool patch_header(const char *filename, const Header &header, const PatchOptions &options = PatchOptions());
+
+/* completes a journaled patch which was interrupted, returns false if there
+ * was nothing to recover */
+bool recover_header(const char *filename);
+
+/* applies fix to the header of every file, failures don't stop the batch */
+PatchResult patch_headers(const std::vector<std::string> &filenames, const HeaderFixer &fix, const PatchOptions &options = PatchOptions());
+
+}
+
+#endif
@@ -28,6 +28,7 @@ namespace iNES {
 class Rom {
 public:
 	Rom(const char *filename);
+	Rom(const uint8_t *data, size_t size);
 	Rom(const Rom &) = delete;
 	Rom &operator=(const Rom &) = delete;
 	Rom(Rom &&)                 = default;
@@ -46,10 +47,21 @@ public:
 	uint8_t *prg_rom() const;
 	uint8_t *chr_rom() const;
 
+public:
+	/* same results as the hashes above, with large sections hashed in chunks
+	 * on several threads, threads of 0 means one per hardware thread */
+	uint32_t prg_hash(unsigned int threads) const;
+	uint32_t chr_hash(unsigned int threads) const;
+	uint32_t rom_hash(unsigned int threads) const;
+
 public:
 	/* functions for writing an iNES file */
 	void write(const char *filename) const;
 
+private:
+	template <class Read>
+	void load(Read read);
+
 private:
 	std::unique_ptr<Header> header_;     /* raw iNES header */
 	std::unique_ptr<uint8_t[]> trainer_; /* pointer to 512 byte trainer data or NULL */
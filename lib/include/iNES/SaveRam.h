@@ -0,0 +1,70 @@
+/*
+Copyright (C) 2000 - 2016 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INES_SAVE_RAM_20261019_H_
+#define INES_SAVE_RAM_20261019_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace iNES {
+
+class Header;
+
+/* battery backed RAM living in a memory mapped .sav file. writes mark the
+ * pages they touch, and sync() only flushes the pages marked since the last
+ * one. the file is created, or grown with zeros, as needed */
+class SaveRam {
+public:
+	SaveRam(const char *filename, size_t size);
+
+	/* sized as the header's PRG-NVRAM followed by its CHR-NVRAM */
+	SaveRam(const char *filename, const Header &header);
+
+	SaveRam(const SaveRam &) = delete;
+	SaveRam &operator=(const SaveRam &) = delete;
+	~SaveRam();
+
+public:
+	uint8_t *data() const;
+	size_t size() const;
+
+public:
+	uint8_t read(size_t offset) const;
+	void write(size_t offset, uint8_t value);
+
+	/* for writes made directly through data() */
+	void mark_dirty(size_t offset, size_t length);
+	bool dirty() const;
+
+	/* wait selects MS_SYNC over MS_ASYNC */
+	void sync(bool wait = true);
+
+private:
+	int fd_        = -1;
+	uint8_t *data_ = nullptr;
+	size_t size_   = 0;
+	size_t page_size_;
+	std::vector<bool> dirty_pages_;
+	bool dirty_ = false;
+};
+
+}
+
+#endif
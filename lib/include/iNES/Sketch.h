@@ -0,0 +1,82 @@
+/*
+Copyright (C) 2000 - 2016 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INES_SKETCH_20261019_H_
+#define INES_SKETCH_20261019_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace iNES {
+
+class Rom;
+
+/* MinHash sketch over the banks of a ROM's PRG and CHR data, two sketches
+ * estimate the fraction of banks their ROMs have in common */
+class Sketch {
+public:
+	static constexpr int Size     = 64;    /* number of min-hash values */
+	static constexpr int BankSize = 0x400; /* smallest bank size a mapper switches */
+
+public:
+	explicit Sketch(const Rom &rom);
+
+public:
+	double similarity(const Sketch &other) const;
+	const std::array<uint32_t, Size> &values() const;
+
+private:
+	std::array<uint32_t, Size> values_;
+};
+
+/* LSH index over sketches, returns candidate near-duplicates without
+ * comparing every pair of ROMs */
+class SketchIndex {
+public:
+	static constexpr int Bands = 16;
+	static constexpr int Rows  = Sketch::Size / Bands;
+
+	struct Match {
+		size_t id;
+		double similarity;
+	};
+
+	struct Pair {
+		size_t first;
+		size_t second;
+		double similarity;
+	};
+
+public:
+	size_t insert(const Sketch &sketch);
+	std::vector<Match> query(const Sketch &sketch, double threshold) const;
+	std::vector<Pair> pairs(double threshold) const;
+	const Sketch &sketch(size_t id) const;
+	size_t size() const;
+
+private:
+	std::vector<Sketch> sketches_;
+	std::array<std::unordered_map<uint64_t, std::vector<size_t>>, Bands> buckets_;
+};
+
+}
+
+#endif